@@ -0,0 +1,172 @@
+#ifndef BATCHWALK_H_
+#define BATCHWALK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "Lattice.h"
+#include "Random.h"
+#include "Vector.h"
+
+// Whether step() is vectorised; either way it takes exactly the same steps
+#if defined(__AVX2__)
+#define BATCH_WALK_VECTORISED 1
+#else
+#define BATCH_WALK_VECTORISED 0
+#endif
+
+/**
+ * Random walks on an N-dimensional lattice taken LANES at a time, for
+ * ensembles of many independent walks (like -d).
+ *
+ * Everything is stored as structures of arrays with one entry per lane: each
+ * lane has its own xoshiro128++ generator, and positions are int32 in units of
+ * half a translation component, so the steps of every lattice (which are all
+ * multiples of a half) are exact integer additions. Every lane runs the same
+ * instructions on its own data, which the compiler turns into SIMD code. Build
+ * with -DBUILD_NATIVE=ON so it can use AVX2 or AVX-512, which have the
+ * per-lane shifts the translation lookup needs; plain SSE2 runs it lane by
+ * lane.
+ *
+ * Positions are limited to about 2^30 in each direction, so walks may be up to
+ * MAX_LENGTH steps long.
+ */
+template<unsigned int N, unsigned int LANES = 16>
+class BatchWalk {
+public:
+    /**
+     * Lane i draws from its own stream, seeded from (seed, first_stream + i).
+     * Throws out_of_range if the lattice has more than MAX_TRANSLATIONS
+     * translations, or one longer than 3.5 in any component */
+    BatchWalk(Lattice<N> lattice, uint64_t seed, uint64_t first_stream)
+    : lattice(lattice), count((uint32_t)lattice.getTranslationSet().size()) {
+        const std::vector<Vector<N> > &translations = lattice.getTranslationSet();
+
+        if (translations.size() > MAX_TRANSLATIONS)
+            throw std::out_of_range("too many translations for a batch walk");
+
+        for (unsigned int d = 0; d < N; ++d) {
+            table[d] = 0;
+
+            for (unsigned int k = 0; k < count; ++k) {
+                int half_units = (int)(translations[k].get(d) * 2);
+
+                if (half_units < -8 || half_units > 7)
+                    throw std::out_of_range("translation too long for a batch walk");
+
+                table[d] |= (uint32_t)(half_units + 8) << (4 * k);
+            }
+        }
+
+        /* Each lane's state is the start of its Xoshiro256 stream, so lanes
+         * are keyed exactly as Walk's streams are and different (seed,
+         * stream) pairs never collide */
+        for (unsigned int lane = 0; lane < LANES; ++lane) {
+            Xoshiro256 stream(seed, first_stream + lane);
+            uint64_t words[2] = { stream.next(), stream.next() };
+
+            // xoshiro128++ never leaves the all-zero state
+            if ((words[0] | words[1]) == 0)
+                words[0] = 1;
+
+            for (int i = 0; i < 2; ++i) {
+                s[2 * i][lane] = (uint32_t)words[i];
+                s[2 * i + 1][lane] = (uint32_t)(words[i] >> 32);
+            }
+        }
+
+        reset();
+    }
+
+    /* Move every lane back to the origin, keeping the generators going */
+    void reset() {
+        for (unsigned int d = 0; d < N; ++d)
+            for (unsigned int lane = 0; lane < LANES; ++lane)
+                position[d][lane] = 0;
+    }
+
+    /* Take `length` more steps on every lane */
+    void walk(long long length) {
+        for (long long i = 0; i < length; ++i)
+            step();
+    }
+
+    /**
+     * Take `length` more steps on every lane, writing the position after each
+     * one to `trajectory`: the half-unit coordinate d of lane l after step i
+     * goes to trajectory[(i * N + d) * LANES + l] */
+    void walk(long long length, int32_t *trajectory) {
+        for (long long i = 0; i < length; ++i) {
+            step();
+
+            for (unsigned int d = 0; d < N; ++d)
+                for (unsigned int lane = 0; lane < LANES; ++lane)
+                    trajectory[(i * N + d) * LANES + lane] = position[d][lane];
+        }
+    }
+
+    /* Current position of `lane`, without the basis applied, as Walk stores it */
+    Vector<N> getPosition(unsigned int lane) const {
+        Vector<N> result;
+
+        for (unsigned int d = 0; d < N; ++d)
+            result.set(d, position[d][lane] / 2.0);
+
+        return result;
+    }
+
+    /* Distance of `lane` from the origin, like Walk::getDistance() */
+    double getDistance(unsigned int lane) const {
+        return lattice.applyBasis(getPosition(lane)).getMagnitude();
+    }
+
+    static unsigned int getLanes() { return LANES; }
+
+    /* Half-unit coordinate `d` of every lane */
+    const int32_t *getCoordinates(unsigned int d) const { return position[d]; }
+
+    static const unsigned int MAX_TRANSLATIONS = 8;
+    static const long long MAX_LENGTH = 1LL << 29;
+
+private:
+    static uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+    void step() {
+        for (unsigned int lane = 0; lane < LANES; ++lane) {
+            /* xoshiro128++ */
+            uint32_t result = rotl(s[0][lane] + s[3][lane], 7) + s[0][lane];
+            uint32_t t = s[1][lane] << 9;
+
+            s[2][lane] ^= s[0][lane];
+            s[3][lane] ^= s[1][lane];
+            s[1][lane] ^= s[2][lane];
+            s[0][lane] ^= s[3][lane];
+
+            s[2][lane] ^= t;
+            s[3][lane] = rotl(s[3][lane], 11);
+
+            // Same multiply-shift as Xoshiro256::below()
+            uint32_t index = (uint32_t)(((uint64_t)result * count) >> 32);
+
+            /* Look the component up in a register rather than in memory, so
+             * there are no gathers */
+            for (unsigned int d = 0; d < N; ++d)
+                position[d][lane] += (int32_t)((table[d] >> (index * 4)) & 15) - 8;
+        }
+    }
+
+    Lattice<N> lattice;
+    uint32_t count;
+
+    /* Component d of translation k, in half units, is in bits 4k to 4k + 3 of
+     * table[d], offset by 8 */
+    uint32_t table[N];
+
+    // Generator state and position of each lane
+    uint32_t s[4][LANES];
+    int32_t position[N][LANES];
+};
+
+#endif /* BATCHWALK_H_ */
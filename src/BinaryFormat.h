@@ -0,0 +1,95 @@
+#ifndef BINARYFORMAT_H_
+#define BINARYFORMAT_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "Lattice.h"
+#include "Vector.h"
+
+namespace Format {
+    /**
+     * Binary output (walkrun --format bin): a header, then fixed-width
+     * records of little-endian doubles until the end of the file.
+     *
+     * The header is, with every integer little-endian:
+     *   bytes 0-7     "WALKGEN" and a null
+     *   8-11          version, BINARY_VERSION
+     *   12-15         what the records are, a Content
+     *   16-19         components per record
+     *   20-23         dimension N of the lattice
+     *   24-39         name of the lattice, padded with nulls
+     *   40-47         seed the output was generated with
+     *   48-(48 + 8N)  basis of the lattice, N doubles
+     */
+    enum Content {
+        STEPS,          // Each step of a walk, basis applied
+        POSITIONS,      // Position after each step of a walk, basis applied
+        SEEDS,          // Each seed of a DLA as it sticks
+        RADII,          // Number of seeds and furthest radius as each one sticks
+        DISTANCES       // Distance from the start to the end of each walk
+    };
+
+    const uint32_t BINARY_VERSION = 1;
+    const size_t NAME_LENGTH = 16;
+
+    /* Bytes in the header for a lattice of dimension `dimension` */
+    inline size_t headerSize(unsigned int dimension) { return 48 + 8 * dimension; }
+
+    inline void putUint32(uint32_t value, char *out) {
+        for (int i = 0; i < 4; ++i)
+            out[i] = (char)(value >> (8 * i));
+    }
+
+    inline void putUint64(uint64_t value, char *out) {
+        for (int i = 0; i < 8; ++i)
+            out[i] = (char)(value >> (8 * i));
+    }
+
+    inline void putDouble(double value, char *out) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        putUint64(bits, out);
+    }
+
+    /**
+     * Write the binary header for records of `components` doubles to an
+     * OutputBuffer or MappedOutput */
+    template<class Output, unsigned int N>
+    void writeHeader(Output &out, Content content, unsigned int components,
+                     const Lattice<N> &lattice, uint64_t seed) {
+        char header[48 + 8 * N];
+        std::memset(header, 0, sizeof(header));
+
+        std::memcpy(header, "WALKGEN", 7);
+        putUint32(BINARY_VERSION, header + 8);
+        putUint32((uint32_t)content, header + 12);
+        putUint32(components, header + 16);
+        putUint32(N, header + 20);
+
+        // Cut to fit, leaving room for a null
+        const std::string &name = lattice.getName();
+        std::memcpy(header + 24, name.data(), std::min(name.size(), NAME_LENGTH - 1));
+
+        putUint64(seed, header + 40);
+
+        for (unsigned int d = 0; d < N; ++d)
+            putDouble(lattice.getBasis().get(d), header + 48 + 8 * d);
+
+        out.write(header, sizeof(header));
+    }
+
+    /* Write `v` as a record, returning its length */
+    template<int N>
+    size_t binary(const Vector<N> &v, char *out) {
+        for (unsigned int d = 0; d < (unsigned int)N; ++d)
+            putDouble(v.get(d), out + 8 * d);
+
+        return 8 * N;
+    }
+}
+
+#endif /* BINARYFORMAT_H_ */
@@ -8,9 +8,44 @@
 
 #include <iostream>
 
+// Don't bother jumping less than this far
+#define MIN_JUMP_RADIUS 2.0
+
+// Steps to take before looking for a jump again after failing to find one
+#define JUMP_CHECK_INTERVAL 4
+
+bool DLA::hasHalfSteps(const Lattice<2> &lattice)
+{
+    const std::vector<Vector<2> > &translations = lattice.getTranslationSet();
+
+    for (size_t i = 0; i < translations.size(); ++i)
+        if (translations[i].get(0) != std::floor(translations[i].get(0)))
+            return true;
+
+    return false;
+}
+
+bool DLA::closeToSeed(Occupancy::Cell cell)
+{
+    if (occupancy_mode == DENSE_GRID)
+        return grid.isNearSeed(cell);
+    if (occupancy_mode == SPARSE_TILES)
+        return tiles.isNearSeed(cell);
+    if (occupancy_mode == CONCURRENT_TILES)
+        return concurrent.isNearSeed(cell);
+
+    return closeToSeed(Occupancy::toPoint(cell));
+}
 
 bool DLA::closeToSeed(Vector<2> point)
 {
+    if (occupancy_mode == DENSE_GRID)
+        return grid.isNearSeed(point);
+    if (occupancy_mode == SPARSE_TILES)
+        return tiles.isNearSeed(point);
+    if (occupancy_mode == CONCURRENT_TILES)
+        return concurrent.isNearSeed(point);
+
     // Check if a seed is close to another seed
     for (size_t i = 0; i < seeds.size(); ++i) {
         if ((seeds.at(i) - point).getMagnitude() < 1.5) {
@@ -21,48 +56,197 @@ bool DLA::closeToSeed(Vector<2> point)
     return false;
 }
 
+bool DLA::isSeed(Vector<2> point)
+{
+    if (occupancy_mode == DENSE_GRID)
+        return grid.isSeed(Occupancy::toCell(point));
+    if (occupancy_mode == SPARSE_TILES)
+        return tiles.isSeed(Occupancy::toCell(point));
+    if (occupancy_mode == CONCURRENT_TILES)
+        return concurrent.isSeed(Occupancy::toCell(point));
+
+    return std::find(seeds.begin(), seeds.end(), point) != seeds.end();
+}
+
+void DLA::addSeed(Vector<2> seed)
+{
+    seeds.push_back(seed);
+
+    if (occupancy_mode == DENSE_GRID)
+        grid.add(seed);
+    else if (occupancy_mode == SPARSE_TILES)
+        tiles.add(seed);
+    else if (occupancy_mode == CONCURRENT_TILES)
+        concurrent.add(seed);
+
+    if (long_jumps)
+        pyramid.add(seed);
+
+    for (size_t i = 0; i < observers.size(); ++i)
+        observers[i](seed, seeds.size());
+}
+
+void DLA::setLongJumps(bool enabled)
+{
+    if (enabled == long_jumps)
+        return;
+
+    long_jumps = enabled;
+    pyramid = OccupancyPyramid();
+
+    if (long_jumps)
+        for (size_t i = 0; i < seeds.size(); ++i)
+            pyramid.add(seeds[i]);
+}
+
+Vector<2> DLA::jump(Vector<2> from, double radius, double angle, bool half_steps)
+{
+    Vector<2> offset(2, radius * std::cos(angle), radius * std::sin(angle));
+
+    return from + Occupancy::toPoint(Occupancy::snapOffset(offset, half_steps));
+}
+
+void DLA::setOccupancyMode(OccupancyMode mode)
+{
+    if (mode == occupancy_mode)
+        return;
+
+    occupancy_mode = mode;
+
+    /* Throw away the old structure and mark all the seeds in the new one */
+    grid = OccupancyGrid();
+    tiles = TiledOccupancy();
+    concurrent = ConcurrentOccupancy();
+
+    if (occupancy_mode == CONCURRENT_TILES)
+        concurrent = ConcurrentOccupancy(ConcurrentOccupancy::DEFAULT_RADIUS);
+
+    for (size_t i = 0; i < seeds.size(); ++i) {
+        if (occupancy_mode == DENSE_GRID)
+            grid.add(seeds[i]);
+        else if (occupancy_mode == SPARSE_TILES)
+            tiles.add(seeds[i]);
+        else if (occupancy_mode == CONCURRENT_TILES)
+            concurrent.add(seeds[i]);
+    }
+}
+
+Vector<2> DLA::returnToCircle(Vector<2> from, double radius, double u, bool half_steps)
+{
+    /* Starting at distance r > radius, a continuous walk first hits the circle
+     * with the Poisson kernel (r^2 - radius^2) / (2 pi |from - point|^2),
+     * which is a wrapped Cauchy distribution around the direction of `from`
+     * with rho = radius / r, sampled here by inverting its CDF */
+    double rho = radius / from.getMagnitude();
+
+    double angle = std::atan2(from.get(1), from.get(0))
+        + 2 * std::atan((1 - rho) / (1 + rho) * std::tan(M_PI * (u - 0.5)));
+
+    /* Aim a unit inside the circle, so rounding onto the lattice can't leave
+     * the walker outside it again */
+    Vector<2> target(2, (radius - 1) * std::cos(angle), (radius - 1) * std::sin(angle));
+
+    return from + Occupancy::toPoint(Occupancy::snapOffset(target - from, half_steps));
+}
+
 Vector<2> DLA::simulate(Vector<2> initial, Walk<2> &walk, int x_boundary, int y_boundary)
+{
+    return walkUntilStuck(initial, walk, x_boundary, y_boundary, 0);
+}
+
+Vector<2> DLA::simulateReturning(Vector<2> initial, Walk<2> &walk, double radius)
+{
+    return walkUntilStuck(initial, walk, 0, 0, radius);
+}
+
+Vector<2> DLA::walkUntilStuck(Vector<2> current, Walk<2> &walk,
+                              int x_boundary, int y_boundary, double return_radius)
 {
     // If there are no seeds, don't do anything, or else we'll just loop infinitely
     if (seeds.size() == 0) {
         return Vector<2>(2, 0.0, 0.0);
     }
 
-    Vector<2> current = initial;
+    bool half_steps = hasHalfSteps(walk.getLattice());
+    int steps_until_jump_check = 0;
+
+    /* Walk in whole cells, so stepping, sticking and wrapping are all integer
+     * operations. Every point the walker can reach is the centre of a cell,
+     * so nothing is lost. */
+    std::vector<Occupancy::Cell> steps = Occupancy::toCells(walk.getLattice().getTranslationSet());
+    Occupancy::Cell cell = Occupancy::toCell(current);
+
+    // Box edges in cells (the boundaries are halved as whole units first)
+    int x_edge = 2 * (x_boundary / 2);
+    int y_edge = y_boundary / 2;
+    double return_radius_squared = return_radius * return_radius;
 
     // Run a random walk until it sticks
     for (;;) {
-        // Add the next step in random walk
-        current += walk.step();
+        double jump_radius = 0;
+
+        if (long_jumps && --steps_until_jump_check <= 0) {
+            jump_radius = pyramid.getEmptyRadius(cell);
+
+            /* Stay far enough inside the box that the landing point doesn't
+             * need wrapping. Walkers that jump out of the circle are simply
+             * returned to it. */
+            if (return_radius == 0) {
+                double to_boundary = std::min(x_boundary / 2 - std::abs(cell.x / 2.0),
+                                              y_boundary / 2 - std::abs((double)cell.y)) - 1;
+
+                jump_radius = std::min(jump_radius, to_boundary);
+            }
+
+            if (jump_radius < MIN_JUMP_RADIUS) {
+                jump_radius = 0;
+                steps_until_jump_check = JUMP_CHECK_INTERVAL;
+            }
+        }
+
+        // Jump through empty space, or add the next step in random walk
+        if (jump_radius > 0)
+            cell = Occupancy::toCell(jump(Occupancy::toPoint(cell), jump_radius,
+                                          walk.getRNG().uniform() * (2 * M_PI), half_steps));
+        else
+            cell += steps[walk.nextIndex()];
 
         // Check if close to seed
-        if (closeToSeed(current)) {
+        if (closeToSeed(cell)) {
             // Stick immediately if stickiness == 1
             if (stickiness == 1) {
-                addSeed(current);
-                return current;
+                addSeed(Occupancy::toPoint(cell));
+                return Occupancy::toPoint(cell);
             }
             
             // Else use the probability
-            double r = std::rand() / (double)RAND_MAX;
+            double r = walk.getRNG().uniform();
             // std::cout << "s = " << stickiness << " r = " << r << std::endl;
 
             if (r < stickiness) {
-                addSeed(current);
-                return current;
+                addSeed(Occupancy::toPoint(cell));
+                return Occupancy::toPoint(cell);
             }
         }
 
+        if (return_radius > 0) {
+            if (cell.getSquaredMagnitude() > return_radius_squared)
+                cell = Occupancy::toCell(returnToCircle(Occupancy::toPoint(cell), return_radius,
+                                                        walk.getRNG().uniform(), half_steps));
+
+            continue;
+        }
+
         // Wrap around if it goes outside
-        if (current.get(0) > (x_boundary / 2))
-            current.set(0, -x_boundary / 2);
-        else if (current.get(0) < (-x_boundary / 2))
-            current.set(0, x_boundary / 2);
-
-        if (current.get(1) > (y_boundary / 2))
-            current.set(1, -y_boundary / 2);
-        else if (current.get(1) < (-y_boundary / 2))
-            current.set(1, y_boundary / 2);
+        if (cell.x > x_edge)
+            cell.x = -x_edge;
+        else if (cell.x < -x_edge)
+            cell.x = x_edge;
+
+        if (cell.y > y_edge)
+            cell.y = -y_edge;
+        else if (cell.y < -y_edge)
+            cell.y = y_edge;
     }
 }
 
@@ -75,17 +259,20 @@ Vector<2> DLA::simulate(Walk<2> &walk)
 {
     /* Generate two random points within the rectangle with width `width`
      * and height `height */
-    int u1 = std::rand();
-    int u2 = std::rand();
-    
-    int rand_x = (u1 % width) - (width / 2);
-    int rand_y = (u2 % height) - (height / 2);
+    int rand_x = (int)walk.getRNG().below(width) - (width / 2);
+    int rand_y = (int)walk.getRNG().below(height) - (height / 2);
 
     // Generate
     return simulate(Vector<2>(2, (double)rand_x, (double)rand_y), walk);
 }
 
 
+void PointDLA::init()
+{
+    setOccupancyMode(SPARSE_TILES);
+    addSeed(Vector<2>(2, 0.0, 0.0));
+}
+
 double PointDLA::getStructureRadius()
 {
     /* Loop through all of the seeds finding the max distance from center */
@@ -93,8 +280,10 @@ double PointDLA::getStructureRadius()
 
     Vector<2> initial(2, 0.0, 0.0);
 
-    for (size_t i = 0; i < getSeeds().size(); ++i) {
-        Vector<2> seed = getSeeds().at(i);
+    Span<Vector<2> > seeds = getSeedView();
+
+    for (size_t i = 0; i < seeds.size(); ++i) {
+        Vector<2> seed = seeds[i];
 
         double radius = (initial - seed).getMagnitude();
         if (radius > max_distance) {
@@ -108,18 +297,24 @@ double PointDLA::getStructureRadius()
 Vector<2> PointDLA::simulateInRadius(Walk<2> &walk, int init_radius)
 {
     /* Generate new point on the radius of a circle with init_radius */
-    double angle = ((double)std::rand() / RAND_MAX) * (2 * M_PI);
+    double angle = walk.getRNG().uniform() * (2 * M_PI);
 
     int x = (int)(init_radius * std::cos(angle));
     int y = (int)(init_radius * std::sin(angle));
 
-    // Calculate boundary distance based on hypotenuse of triangle
-    // with opposite and adjacent of the radius (plus a fudge factor)
-    int boundary_distance = (int)(std::sqrt(2) * (init_radius + 50));
-
     Vector<2> current(2, (double)x, (double)y);
 
-    Vector<2> newSeed = simulate(current, walk, boundary_distance, boundary_distance);
+    Vector<2> newSeed;
+
+    if (boundary_mode == RETURN_TO_CIRCLE) {
+        newSeed = simulateReturning(current, walk, init_radius);
+    } else {
+        // Calculate boundary distance based on hypotenuse of triangle
+        // with opposite and adjacent of the radius (plus a fudge factor)
+        int boundary_distance = (int)(std::sqrt(2) * (init_radius + 50));
+
+        newSeed = simulate(current, walk, boundary_distance, boundary_distance);
+    }
 
     // Check if new furthest seed
     if (newSeed.getMagnitude() > furthest_radius)
@@ -151,56 +346,43 @@ Vector<2> LineDLA::simulate(Walk<2> &walk)
 {
     const int width = getWidth();
 
-    int x = (std::rand() % (width * 2)) - width;
+    int x = (int)walk.getRNG().below(width * 2) - width;
 
     //int y = -std::abs(std::rand() % (std::abs(min_y) + 50));
     int y = min_y - 50;
 
-    Vector<2> current(2, (double)x, (double)y);
+    std::vector<Occupancy::Cell> steps = Occupancy::toCells(walk.getLattice().getTranslationSet());
+    Occupancy::Cell cell(2 * x, y);
 
     /* We reimplement the simulate function here because we need to alter
      * the way that we calculated the boundaries. */
 
     // Generate until we hit another particle
     for (;;) {
-        current += walk.step();
+        cell += steps[walk.nextIndex()];
 
         // Check if close to seed
-        if (closeToSeed(current)) {
-            // Stick immediately if stickiness == 1
-            if (stickiness == 1) {
-                addSeed(current);
-
-                // See if the new seed is the highest yet
-                if (current.get(1) < min_y)
-                    min_y = current.get(1);
-
-                return current;
-            }
-            
-            // Else use the probability
-            double r = std::rand() / RAND_MAX;
-            
-            if (r < stickiness) {
-                addSeed(current);
+        if (closeToSeed(cell)) {
+            // Stick immediately if stickiness == 1, else use the probability
+            if (stickiness == 1 || walk.getRNG().uniform() < stickiness) {
+                addSeed(Occupancy::toPoint(cell));
 
                 // See if the new seed is the highest yet
-                if (current.get(1) < min_y)
-                    min_y = current.get(1);
+                if (cell.y < min_y)
+                    min_y = cell.y;
 
-                return current;
+                return Occupancy::toPoint(cell);
             }
         }
 
-
         // Wrap around if it goes outside width
-	if (current.get(0) > width)
-	    current.set(0, -width);
-	if (current.get(0) < -width)
-	    current.set(0, width);
+        if (cell.x > 2 * width)
+            cell.x = -2 * width;
+        if (cell.x < -2 * width)
+            cell.x = 2 * width;
 
         // "Push it back" if it gets too far
-	if (current.get(1) < min_y - 50)
-	    current.set(1, min_y - 10);
+        if (cell.y < min_y - 50)
+            cell.y = min_y - 10;
     }
 }
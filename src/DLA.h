@@ -5,8 +5,12 @@
 
 // 2-dimensional DLAs
 
+#include <cstddef>
+#include <functional>
 #include <vector>
 
+#include "Occupancy.h"
+#include "Span.h"
 #include "Vector.h"
 #include "Walk.h"
 
@@ -22,10 +26,20 @@
  */
 class DLA {
 public:
-    DLA() : width(1000), height(1000), stickiness(1) { }
-    DLA(double stickiness) : stickiness(stickiness) { } 
-    DLA(int width, int height) : width(width), height(height), stickiness(1) { }
-    DLA(int width, int height, double stickiness) : width(width), height(height), stickiness(stickiness) { }
+    /**
+     * How closeToSeed() finds nearby seeds: by checking the distance to every
+     * seed in turn (kept for validation), or with a single lookup in either a
+     * dense OccupancyGrid, a sparse TiledOccupancy, or a ConcurrentOccupancy
+     * that other threads can read while addSeed() updates it */
+    enum OccupancyMode { LINEAR_SCAN, DENSE_GRID, SPARSE_TILES, CONCURRENT_TILES };
+
+    DLA() : width(1000), height(1000), occupancy_mode(DENSE_GRID), long_jumps(false), stickiness(1) { }
+    DLA(double stickiness)
+    : width(1000), height(1000), occupancy_mode(DENSE_GRID), long_jumps(false), stickiness(stickiness) { }
+    DLA(int width, int height)
+    : width(width), height(height), occupancy_mode(DENSE_GRID), long_jumps(false), stickiness(1) { }
+    DLA(int width, int height, double stickiness)
+    : width(width), height(height), occupancy_mode(DENSE_GRID), long_jumps(false), stickiness(stickiness) { }
 
     int getHeight() { return height; }
     void setHeight(int height) { this->height = height; }
@@ -33,17 +47,49 @@ public:
     int getWidth() { return width; }
     void setWidth(int width) { this->width = width; }
 
+    OccupancyMode getOccupancyMode() { return occupancy_mode; }
+    // Rebuilds the structure for the new mode from the current seeds
+    void setOccupancyMode(OccupancyMode mode);
+
+    bool getLongJumps() { return long_jumps; }
+
+    /**
+     * When enabled, walkers far enough from every seed jump straight onto a
+     * random point of the largest empty circle around them (found with an
+     * OccupancyPyramid), and only take single lattice steps near the cluster */
+    void setLongJumps(bool enabled);
+
     /* Return true if the point is within 1 pixel (cardinally or diagonally) of any seed */
     bool closeToSeed(Vector<2> point);
+    bool closeToSeed(Occupancy::Cell cell);
+
+    /* Return true if there is a seed at exactly this point */
+    bool isSeed(Vector<2> point);
 
     /* Return all the current seeds of the DLA */
     std::vector<Vector<2> > getSeeds() { return seeds; }
-    void addSeed(Vector<2> seed) { seeds.push_back(seed); }
+
+    /**
+     * View of the current seeds, without copying them. Only valid until the
+     * next seed is added */
+    Span<Vector<2> > getSeedView() const { return seeds; }
+    size_t getSeedCount() const { return seeds.size(); }
+    void addSeed(Vector<2> seed);
+
+    /**
+     * Called by addSeed() with each new seed and the number of seeds including
+     * it, so output and statistics can follow the cluster as it grows without
+     * copying it. Observers run on whichever thread adds the seed, which in a
+     * ParallelPointDLA is while it holds its commit lock */
+    typedef std::function<void(const Vector<2> &seed, size_t count)> SeedObserver;
+    void addSeedObserver(SeedObserver observer) { observers.push_back(observer); }
 
     /*
      * Simulate once, returning Vector<2> of new seed, wrapping if particle leaves
      * x_boundary / 2 or y_boundary / 2 in either direction, assuming centered about (0, 0)
      *
+     * Steps are drawn with walk.nextStep(), so nothing is added to the walk
+     *
      * Returns (0, 0) if there are no seeds currently
      */
     Vector<2> simulate(Vector<2> initial, Walk<2> &walk, int x_boundary, int y_boundary);
@@ -55,10 +101,51 @@ public:
      * Returns (0, 0) if there are no seeds currently */
     Vector<2> simulate(Walk<2> &walk);
 
+protected:
+    /**
+     * Simulate once like simulate(Vector<2>, Walk<2> &, int, int), but instead
+     * of wrapping, a walker that gets further than `radius` from (0, 0) is put
+     * straight back onto the circle of that radius, at the point where a
+     * continuous walk from there would first hit it */
+    Vector<2> simulateReturning(Vector<2> initial, Walk<2> &walk, double radius);
+
+    /**
+     * Does the lattice have translations of half a unit in x (before the basis
+     * is applied)? If so jumps have to keep walkers on their own sublattice */
+    static bool hasHalfSteps(const Lattice<2> &lattice);
+
+    /**
+     * Move to the point at `angle` on the circle of radius `radius` around
+     * `from`, rounded onto the lattice */
+    static Vector<2> jump(Vector<2> from, double radius, double angle, bool half_steps);
+
+    /**
+     * Move from outside the circle of radius `radius` around (0, 0) onto it,
+     * with the angle sampled from the harmonic measure seen from `from` using
+     * `u`, uniform on [0, 1] */
+    static Vector<2> returnToCircle(Vector<2> from, double radius, double u, bool half_steps);
+
 private:
+    /**
+     * The walk shared by simulate() and simulateReturning(), which wraps
+     * around the box if `return_radius` is 0 */
+    Vector<2> walkUntilStuck(Vector<2> current, Walk<2> &walk,
+                             int x_boundary, int y_boundary, double return_radius);
+
     int width, height;
 
     std::vector<Vector<2> > seeds;
+    std::vector<SeedObserver> observers;
+
+    // Only the structure for the current occupancy mode is kept up to date
+    OccupancyGrid grid;
+    TiledOccupancy tiles;
+    ConcurrentOccupancy concurrent;
+    OccupancyMode occupancy_mode;
+
+    // Only kept up to date while long jumps are enabled
+    OccupancyPyramid pyramid;
+    bool long_jumps;
 
 protected:
     double stickiness;
@@ -69,11 +156,25 @@ protected:
  */
 class PointDLA : public DLA {
 public:
-	PointDLA() : DLA(), init_radius(10), furthest_radius(0) { addSeed(Vector<2>(0, 0)); }
+    /**
+     * What happens to walkers that wander away from the launch circle: either
+     * they wrap around a square box around it, or they are returned to the
+     * launch circle in a single step (see DLA::simulateReturning()) */
+    enum BoundaryMode { WRAP_BOX, RETURN_TO_CIRCLE };
+
+	PointDLA() : DLA(), init_radius(10), furthest_radius(0), boundary_mode(WRAP_BOX) { init(); }
  	PointDLA(double stickiness)
-    : DLA(stickiness), init_radius(10), furthest_radius(0) { addSeed(Vector<2>(0, 0)); }
+    : DLA(stickiness), init_radius(10), furthest_radius(0), boundary_mode(WRAP_BOX) { init(); }
  	PointDLA(int init_radius, double stickiness)
-    : DLA(stickiness), init_radius(init_radius), furthest_radius(0) { addSeed(Vector<2>(0, 0)); }
+    : DLA(stickiness), init_radius(init_radius), furthest_radius(0), boundary_mode(WRAP_BOX) { init(); }
+
+    BoundaryMode getBoundaryMode() { return boundary_mode; }
+    void setBoundaryMode(BoundaryMode mode) { boundary_mode = mode; }
+
+    /**
+     * Add the initial seed at (0, 0). Point DLAs can grow arbitrarily far, so
+     * they default to sparse tiles rather than a dense grid */
+    void init();
 
     // Get radius of structure by calculating directly (SLOWER)
     double getStructureRadius();
@@ -97,6 +198,7 @@ public:
 private:
     int init_radius;
     double furthest_radius;
+    BoundaryMode boundary_mode;
 };
 
 
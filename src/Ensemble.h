@@ -0,0 +1,300 @@
+#ifndef ENSEMBLE_H_
+#define ENSEMBLE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BatchWalk.h"
+#include "Lattice.h"
+#include "Random.h"
+#include "Vector.h"
+#include "Walk.h"
+
+/**
+ * Runs an ensemble of independent walks on several threads, recording the
+ * distance between the start and end of each.
+ *
+ * Walk i always draws from stream first_stream + i of the seed, so the
+ * distances are the same however many threads there are. Threads take the
+ * next chunk of walks as long as it fits in a window of WINDOW_CHUNKS chunks
+ * a thread, and the distances are handed on in order from the window as soon
+ * as their chunk is done, so memory doesn't grow with the number of walks.
+ * Each thread keeps its own moments (and histogram, if asked for), which are
+ * only combined once every thread has finished.
+ */
+template<unsigned int N>
+class Ensemble {
+public:
+    /* How each walk's end point is found */
+    enum Method {
+        STEP_BY_STEP,   // Walk::generateEnd()
+        MULTINOMIAL,    // Walk::sampleEnd()
+        BATCH           // BatchWalk, CHUNK_SIZE walks at once
+    };
+
+    Ensemble(Lattice<N> lattice, int threads, uint64_t seed, uint64_t first_stream)
+    : lattice(lattice), threads(threads), seed(seed), first_stream(first_stream),
+      method(BATCH), bin_count(0), bin_width(1) {}
+
+    int getThreads() { return threads; }
+    void setThreads(int threads) { this->threads = threads; }
+
+    /**
+     * Changing the method changes the walks, but not their distribution. The
+     * default is BATCH, whatever the build, so a seed always gives the same
+     * distances; it is only faster with AVX2 (see BatchWalk) */
+    Method getMethod() { return method; }
+    void setMethod(Method method) { this->method = method; }
+
+    /**
+     * Keep a histogram of the distances in `bin_count` bins of `bin_width`,
+     * the last of which also holds every distance further out. There is no
+     * histogram with 0 bins, which is the default */
+    void setHistogram(size_t bin_count, double bin_width) {
+        this->bin_count = bin_count;
+        this->bin_width = bin_width;
+    }
+
+    size_t getBinCount() { return bin_count; }
+    double getBinWidth() { return bin_width; }
+
+    /**
+     * Run `count` walks of `length` steps, returning the distance each one
+     * ended up from its start, in walk order */
+    std::vector<double> run(long long length, size_t count) {
+        std::vector<double> distances;
+        distances.reserve(count);
+
+        run(length, count, [&distances](double distance) { distances.push_back(distance); });
+
+        return distances;
+    }
+
+    /**
+     * Run `count` walks of `length` steps, handing the distance each one
+     * ended up from its start to `receive` on this thread, in walk order, as
+     * soon as it and every walk before it have finished */
+    void run(long long length, size_t count, const std::function<void(double)> &receive) {
+        // Too long for the lanes' positions
+        Method run_method = method;
+        if (run_method == BATCH && length > BatchWalk<N>::MAX_LENGTH)
+            run_method = STEP_BY_STEP;
+
+        std::vector<Partial> partials(std::max(threads, 1));
+        Window window(count, WINDOW_CHUNKS * partials.size());
+        std::vector<std::thread> workers;
+
+        for (size_t i = 0; i < partials.size(); ++i)
+            workers.push_back(std::thread(&Ensemble::work, this, length, run_method,
+                                          &window, &partials[i]));
+
+        try {
+            for (size_t chunk = 0; chunk < window.chunks; ++chunk)
+                deliver(window, chunk, receive);
+        } catch (...) {
+            // Let the workers finish what they have and stop
+            window.stop();
+
+            for (size_t i = 0; i < workers.size(); ++i)
+                workers[i].join();
+
+            throw;
+        }
+
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+
+        /* Combine what each thread saw */
+        total = Partial();
+
+        for (size_t i = 0; i < partials.size(); ++i) {
+            total.count += partials[i].count;
+            total.sum += partials[i].sum;
+            total.sum_squares += partials[i].sum_squares;
+            total.sum_fourths += partials[i].sum_fourths;
+
+            if (partials[i].histogram.size() > total.histogram.size())
+                total.histogram.resize(partials[i].histogram.size(), 0);
+
+            for (size_t j = 0; j < partials[i].histogram.size(); ++j)
+                total.histogram[j] += partials[i].histogram[j];
+        }
+    }
+
+    /* Moments of the distances from the last run() */
+    size_t getCount() { return total.count; }
+    double getMean() { return total.sum / total.count; }
+    double getMeanSquare() { return total.sum_squares / total.count; }
+    double getMeanFourth() { return total.sum_fourths / total.count; }
+    double getVariance() { return getMeanSquare() - getMean() * getMean(); }
+
+    /**
+     * Number of distances from the last run() in each bin, bin i holding
+     * distances from i * getBinWidth() up to (i + 1) * getBinWidth(), or
+     * nothing if there is no histogram */
+    const std::vector<size_t> &getHistogram() { return total.histogram; }
+
+    // Walks handed to a thread at once, and the lanes of a batch
+    static const size_t CHUNK_SIZE = 16;
+
+    // Chunks a thread may be ahead of the oldest one not yet handed on
+    static const size_t WINDOW_CHUNKS = 4;
+
+private:
+    /* What one thread has seen so far */
+    struct Partial {
+        Partial() : count(0), sum(0), sum_squares(0), sum_fourths(0) {}
+
+        size_t count;
+        double sum, sum_squares, sum_fourths;
+        std::vector<size_t> histogram;
+    };
+
+    /* Distances of the chunks that have been taken but not yet handed on, in
+     * a ring of slots, chunk c going in slot c % slots */
+    struct Window {
+        Window(size_t count, size_t slots)
+        : count(count), chunks((count + CHUNK_SIZE - 1) / CHUNK_SIZE), next(0), delivered(0),
+          distances(slots * CHUNK_SIZE), ready(slots, false) {}
+
+        /* Hand out no more chunks */
+        void stop() {
+            std::lock_guard<std::mutex> guard(lock);
+            next = chunks;
+            space.notify_all();
+        }
+
+        size_t count, chunks;
+
+        // Next chunk to hand out, and chunks handed on so far
+        size_t next, delivered;
+
+        std::vector<double> distances;
+        std::vector<bool> ready;
+
+        std::mutex lock;
+        std::condition_variable space, filled;
+    };
+
+    void work(long long length, Method run_method, Window *window, Partial *result) {
+        // Kept on this thread's stack until the end, so threads never share a cache line
+        Partial partial;
+        Walk<N> walk(lattice, Xoshiro256());
+        double distances[CHUNK_SIZE];
+
+        if (bin_count > 0)
+            partial.histogram.assign(bin_count, 0);
+
+        for (;;) {
+            size_t chunk;
+
+            {
+                std::unique_lock<std::mutex> guard(window->lock);
+                window->space.wait(guard, [window]() {
+                    return window->next == window->chunks
+                        || window->next < window->delivered + window->ready.size();
+                });
+
+                if (window->next == window->chunks)
+                    break;
+
+                chunk = window->next++;
+            }
+
+            size_t start = chunk * CHUNK_SIZE;
+            size_t end = std::min(start + CHUNK_SIZE, window->count);
+
+            if (run_method == BATCH) {
+                BatchWalk<N, CHUNK_SIZE> batch(lattice, seed, first_stream + start);
+                batch.walk(length);
+
+                for (size_t i = start; i < end; ++i)
+                    distances[i - start] = batch.getDistance((unsigned int)(i - start));
+            } else {
+                for (size_t i = start; i < end; ++i) {
+                    walk.getRNG().setSeed(seed, first_stream + i);
+
+                    Vector<N> position = run_method == MULTINOMIAL ? walk.sampleEnd(length)
+                                                                   : walk.generateEnd(length);
+
+                    distances[i - start] = lattice.applyBasis(position).getMagnitude();
+                }
+            }
+
+            for (size_t i = start; i < end; ++i)
+                record(distances[i - start], partial);
+
+            {
+                std::lock_guard<std::mutex> guard(window->lock);
+                size_t slot = chunk % window->ready.size();
+
+                std::copy(distances, distances + (end - start),
+                          window->distances.begin() + slot * CHUNK_SIZE);
+                window->ready[slot] = true;
+            }
+
+            window->filled.notify_one();
+        }
+
+        *result = partial;
+    }
+
+    /* Wait for `chunk` to be done, then hand its distances to `receive` */
+    void deliver(Window &window, size_t chunk, const std::function<void(double)> &receive) {
+        double distances[CHUNK_SIZE];
+        size_t start = chunk * CHUNK_SIZE;
+        size_t end = std::min(start + CHUNK_SIZE, window.count);
+
+        {
+            std::unique_lock<std::mutex> guard(window.lock);
+            size_t slot = chunk % window.ready.size();
+
+            window.filled.wait(guard, [&window, slot]() { return window.ready[slot]; });
+
+            std::copy(window.distances.begin() + slot * CHUNK_SIZE,
+                      window.distances.begin() + slot * CHUNK_SIZE + (end - start), distances);
+            window.ready[slot] = false;
+            ++window.delivered;
+        }
+
+        window.space.notify_all();
+
+        // Outside the lock, so slow output doesn't hold up the workers
+        for (size_t i = 0; i < end - start; ++i)
+            receive(distances[i]);
+    }
+
+    void record(double distance, Partial &partial) {
+        double square = distance * distance;
+
+        ++partial.count;
+        partial.sum += distance;
+        partial.sum_squares += square;
+        partial.sum_fourths += square * square;
+
+        if (bin_count > 0)
+            ++partial.histogram[std::min((size_t)(distance / bin_width), bin_count - 1)];
+    }
+
+    Lattice<N> lattice;
+    int threads;
+    uint64_t seed;
+    uint64_t first_stream;
+    Method method;
+
+    // No histogram if bin_count is 0
+    size_t bin_count;
+    double bin_width;
+
+    // Combined results of the last run()
+    Partial total;
+};
+
+#endif /* ENSEMBLE_H_ */
@@ -0,0 +1,264 @@
+
+#include "Image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+// Largest length of a deflate stored block
+#define STORED_BLOCK_SIZE 65535
+
+namespace {
+    /* CRC-32 of every byte, built once on first use */
+    struct CrcTable {
+        CrcTable() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+
+                entries[i] = c;
+            }
+        }
+
+        uint32_t entries[256];
+    };
+
+    void putBigEndian(uint32_t value, std::string &out) {
+        for (int i = 3; i >= 0; --i)
+            out.push_back((char)(value >> (8 * i)));
+    }
+
+    /* Write a PNG chunk: length, type, data and the CRC of the type and data */
+    void writeChunk(std::ostream &os, const char *type, const std::string &data) {
+        std::string chunk;
+        putBigEndian((uint32_t)data.size(), chunk);
+        chunk.append(type, 4);
+        chunk.append(data);
+
+        const uint8_t *crc_start = (const uint8_t *)chunk.data() + 4;
+        putBigEndian(Image::crc32(crc_start, data.size() + 4), chunk);
+
+        os.write(chunk.data(), chunk.size());
+    }
+}
+
+const uint8_t Image::WHITE;
+const uint8_t Image::BLACK;
+const uint8_t SeedRaster::ARRIVAL_SHADE;
+
+void Image::fill(int x, int y, int w, int h, uint8_t value)
+{
+    int x_end = std::min(x + w, width), y_end = std::min(y + h, height);
+
+    for (int j = std::max(y, 0); j < y_end; ++j)
+        for (int i = std::max(x, 0); i < x_end; ++i)
+            pixels[(size_t)j * width + i] = value;
+}
+
+void Image::writePGM(std::ostream &os) const
+{
+    os << "P5\n" << width << " " << height << "\n255\n";
+
+    if (!pixels.empty())
+        os.write((const char *)&pixels[0], pixels.size());
+}
+
+void Image::writePNG(std::ostream &os) const
+{
+    static const char SIGNATURE[] = "\x89PNG\r\n\x1a\n";
+    os.write(SIGNATURE, 8);
+
+    /* 8-bit grayscale, deflate, adaptive filtering, no interlacing */
+    std::string header;
+    putBigEndian(width, header);
+    putBigEndian(height, header);
+    header.push_back(8);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    writeChunk(os, "IHDR", header);
+
+    // Every row starts with its filter type, 0 for none
+    std::vector<uint8_t> raw;
+    raw.reserve((size_t)(width + 1) * height);
+
+    for (int y = 0; y < height; ++y) {
+        raw.push_back(0);
+        raw.insert(raw.end(), pixels.begin() + (size_t)y * width, pixels.begin() + (size_t)(y + 1) * width);
+    }
+
+    /* zlib stream: a header for deflate with a 32K window and no
+     * compression, stored blocks of up to 64K, then the Adler-32 */
+    std::string data;
+    data.push_back(0x78);
+    data.push_back(0x01);
+
+    size_t offset = 0;
+
+    do {
+        size_t length = std::min(raw.size() - offset, (size_t)STORED_BLOCK_SIZE);
+        bool last = offset + length == raw.size();
+
+        data.push_back(last ? 1 : 0);
+        data.push_back((char)(length & 0xff));
+        data.push_back((char)(length >> 8));
+        data.push_back((char)(~length & 0xff));
+        data.push_back((char)((~length >> 8) & 0xff));
+        data.append((const char *)raw.data() + offset, length);
+
+        offset += length;
+    } while (offset < raw.size());
+
+    putBigEndian(adler32(raw.data(), raw.size()), data);
+    writeChunk(os, "IDAT", data);
+
+    writeChunk(os, "IEND", std::string());
+}
+
+bool Image::save(const std::string &filename) const
+{
+    std::ofstream file(filename.c_str(), std::ios::binary);
+
+    if (!file)
+        return false;
+
+    bool png = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".png") == 0;
+
+    if (png)
+        writePNG(file);
+    else
+        writePGM(file);
+
+    return (bool)file;
+}
+
+uint32_t Image::crc32(const uint8_t *data, size_t n, uint32_t crc)
+{
+    static const CrcTable table;
+
+    crc = ~crc;
+
+    for (size_t i = 0; i < n; ++i)
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+uint32_t Image::adler32(const uint8_t *data, size_t n, uint32_t adler)
+{
+    uint32_t a = adler & 0xffff, b = adler >> 16;
+
+    // Largest run before the sums could overflow
+    const size_t RUN = 5552;
+
+    while (n > 0) {
+        size_t run = std::min(n, RUN);
+        n -= run;
+
+        for (size_t i = 0; i < run; ++i) {
+            a += *data++;
+            b += a;
+        }
+
+        a %= 65521;
+        b %= 65521;
+    }
+
+    return (b << 16) | a;
+}
+
+
+SeedRaster SeedRaster::fit(Span<Vector<2> > seeds, int scale, int margin)
+{
+    if (seeds.empty())
+        return SeedRaster(2 * margin, 2 * margin, scale);
+
+    double min_x = seeds[0].get(0), max_x = min_x;
+    double min_y = seeds[0].get(1), max_y = min_y;
+
+    for (size_t i = 1; i < seeds.size(); ++i) {
+        min_x = std::min(min_x, seeds[i].get(0));
+        max_x = std::max(max_x, seeds[i].get(0));
+        min_y = std::min(min_y, seeds[i].get(1));
+        max_y = std::max(max_y, seeds[i].get(1));
+    }
+
+    int left = (int)std::floor(min_x * scale), right = (int)std::floor(max_x * scale) + scale;
+    int top = (int)std::floor(min_y * scale), bottom = (int)std::floor(max_y * scale) + scale;
+
+    return SeedRaster(right - left + 2 * margin, bottom - top + 2 * margin, scale,
+                      margin - left, margin - top);
+}
+
+void SeedRaster::draw(const Vector<2> &seed, uint8_t shade)
+{
+    image.fill(toPixelX(seed), toPixelY(seed), scale, scale, shade);
+}
+
+void SeedRaster::draw(Span<Vector<2> > seeds, bool by_arrival)
+{
+    for (size_t i = 0; i < seeds.size(); ++i) {
+        uint8_t shade = Image::BLACK;
+
+        if (by_arrival && seeds.size() > 1)
+            shade = (uint8_t)(ARRIVAL_SHADE * i / (seeds.size() - 1));
+
+        draw(seeds[i], shade);
+    }
+}
+
+int SeedRaster::toPixelX(const Vector<2> &seed) const
+{
+    return origin_x + (int)std::floor(seed.get(0) * scale);
+}
+
+int SeedRaster::toPixelY(const Vector<2> &seed) const
+{
+    return origin_y + (int)std::floor(seed.get(1) * scale);
+}
+
+
+Y4MWriter::Y4MWriter(std::ostream &os, int width, int height, int fps)
+: os(os), width(width + width % 2), height(height + height % 2), frames(0)
+{
+    // Mid gray in both chroma planes, each a quarter of the size
+    chroma.assign((size_t)this->width * this->height / 2, 128);
+
+    os << "YUV4MPEG2 W" << this->width << " H" << this->height << " F" << fps
+       << ":1 Ip A1:1 C420jpeg\n";
+}
+
+void Y4MWriter::writeFrame(const Image &image)
+{
+    if (image.getWidth() != width || image.getHeight() != height)
+        throw std::out_of_range("frame is not the size of the video");
+
+    os.write("FRAME\n", 6);
+    os.write((const char *)image.getPixels().data(), image.getPixels().size());
+    os.write((const char *)chroma.data(), chroma.size());
+
+    ++frames;
+}
+
+
+void SeedVideo::add(const Vector<2> &seed)
+{
+    raster.draw(seed);
+
+    if (++pending == frame_interval) {
+        writer.writeFrame(raster.getImage());
+        pending = 0;
+    }
+}
+
+void SeedVideo::finish()
+{
+    if (pending > 0)
+        writer.writeFrame(raster.getImage());
+
+    pending = 0;
+}
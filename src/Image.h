@@ -0,0 +1,157 @@
+#ifndef IMAGE_H_
+#define IMAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Span.h"
+#include "Vector.h"
+
+/**
+ * 8-bit grayscale image, written as binary PGM or PNG without any libraries.
+ *
+ * PNGs are compressed with deflate's stored (uncompressed) blocks, so every
+ * PNG reader can open them and writing one costs little more than a copy,
+ * but they are no smaller than the PGM. Convert with any image tool if size
+ * matters.
+ */
+class Image {
+public:
+    Image() : width(0), height(0) { }
+    Image(int width, int height, uint8_t background = WHITE)
+    : width(width), height(height), pixels((size_t)width * height, background) { }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    /* Rows from the top, each getWidth() pixels from the left */
+    const std::vector<uint8_t> &getPixels() const { return pixels; }
+
+    uint8_t get(int x, int y) const { return pixels[(size_t)y * width + x]; }
+
+    /* Set the pixel at (x, y), ignoring points outside the image */
+    void set(int x, int y, uint8_t value) {
+        if (x >= 0 && x < width && y >= 0 && y < height)
+            pixels[(size_t)y * width + x] = value;
+    }
+
+    /* Set every pixel of the `w` by `h` rectangle from (x, y), clipped to the image */
+    void fill(int x, int y, int w, int h, uint8_t value);
+
+    void writePGM(std::ostream &os) const;
+    void writePNG(std::ostream &os) const;
+
+    /**
+     * Write to `filename`, as a PNG if it ends in ".png" and a PGM otherwise.
+     * Returns false if the file couldn't be written */
+    bool save(const std::string &filename) const;
+
+    /* Checksums used by PNG (CRC-32 of each chunk) and zlib (Adler-32 of the data) */
+    static uint32_t crc32(const uint8_t *data, size_t n, uint32_t crc = 0);
+    static uint32_t adler32(const uint8_t *data, size_t n, uint32_t adler = 1);
+
+    static const uint8_t WHITE = 255;
+    static const uint8_t BLACK = 0;
+
+private:
+    int width, height;
+    std::vector<uint8_t> pixels;
+};
+
+/**
+ * Draws DLA seeds (without the basis applied, as DLA stores them) onto an
+ * image, each as a `scale` by `scale` square of pixels at `scale` pixels per
+ * unit, with (0, 0) at the pixel (origin_x, origin_y). Rows go down the image
+ * as y increases, as in imagegen/generate_video.py.
+ */
+class SeedRaster {
+public:
+    SeedRaster(int width, int height, int scale)
+    : image(width, height), scale(scale), origin_x(width / 2), origin_y(height / 2) { }
+    SeedRaster(int width, int height, int scale, int origin_x, int origin_y)
+    : image(width, height), scale(scale), origin_x(origin_x), origin_y(origin_y) { }
+
+    /* Raster just big enough for every seed in `seeds`, plus `margin` pixels all round */
+    static SeedRaster fit(Span<Vector<2> > seeds, int scale, int margin);
+
+    void draw(const Vector<2> &seed, uint8_t shade = Image::BLACK);
+
+    /**
+     * Draw every seed in `seeds`, in black, or if `by_arrival` shaded from
+     * black for the first to ARRIVAL_SHADE for the last, so the order the
+     * cluster grew in shows */
+    void draw(Span<Vector<2> > seeds, bool by_arrival);
+
+    const Image &getImage() const { return image; }
+
+    // Shade of the last seed when drawing by arrival, light enough to see on white
+    static const uint8_t ARRIVAL_SHADE = 220;
+
+private:
+    /* Pixel of the top left of the seed's square */
+    int toPixelX(const Vector<2> &seed) const;
+    int toPixelY(const Vector<2> &seed) const;
+
+    Image image;
+    int scale;
+    int origin_x, origin_y;
+};
+
+/**
+ * Raw video as a YUV4MPEG2 (Y4M) stream, which ffmpeg and most players read
+ * directly (e.g. `ffmpeg -i dla.y4m dla.mp4`). Frames are grayscale images;
+ * the chroma planes are constant, so they are built once and copied out.
+ */
+class Y4MWriter {
+public:
+    /* Writes the stream header, rounding odd sizes up for the 4:2:0 chroma */
+    Y4MWriter(std::ostream &os, int width, int height, int fps);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    /* Write `image`, which must be getWidth() by getHeight(), as the next frame */
+    void writeFrame(const Image &image);
+
+    size_t getFrames() const { return frames; }
+
+private:
+    std::ostream &os;
+    int width, height;
+    std::vector<uint8_t> chroma;
+    size_t frames;
+};
+
+/**
+ * Video of a DLA growing: a framebuffer with (0, 0) in the centre that each
+ * new seed is drawn onto as it arrives (see DLA::addSeedObserver()), and a
+ * Y4M frame of it written every `frame_interval` seeds. Drawing a seed only
+ * touches its own pixels, so the framebuffer never has to be redrawn.
+ */
+class SeedVideo {
+public:
+    SeedVideo(std::ostream &os, int size, int scale, int fps, size_t frame_interval)
+    : raster(size + size % 2, size + size % 2, scale), writer(os, size, size, fps),
+      frame_interval(frame_interval > 0 ? frame_interval : 1), pending(0) { }
+
+    /* Draw `seed`, writing a frame if it is the last of an interval */
+    void add(const Vector<2> &seed);
+
+    /* Write a frame of any seeds added since the last one */
+    void finish();
+
+    size_t getFrames() const { return writer.getFrames(); }
+
+private:
+    SeedRaster raster;
+    Y4MWriter writer;
+    size_t frame_interval;
+
+    // Seeds drawn since the last frame
+    size_t pending;
+};
+
+#endif /* IMAGE_H_ */
@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <map>
+#include <string>
 #include <vector>
 #include "Vector.h"
 
@@ -15,13 +16,15 @@ public:
     /* An N-dimensional lattice basis vector expressed in cartesian coordinates */
     typedef Vector<N> Basis;
 
-    Basis getBasis() { return basis; }
-    std::vector<Basis> getTranslationSet() { return translations; }
+    Basis getBasis() const { return basis; }
+    /* Name of the lattice, for output headers; empty if it has none */
+    const std::string &getName() const { return name; }
+    const std::vector<Basis> &getTranslationSet() const { return translations; }
 
     /**
      * Apply basis set to given vector to transform it into the lattice
      */
-    Basis applyBasis(Vector<N> vector) {
+    Basis applyBasis(Vector<N> vector) const {
 		return vector * getBasis();
     }
 protected:
@@ -31,6 +34,8 @@ protected:
     // Basis set
     Basis basis;
 
+    std::string name;
+
     // Expressed in units of basis
     std::vector<Basis> translations;
 };
@@ -41,6 +46,7 @@ public:
 
 private:
     void init() {
+		name = "triangular";
 		basis = Vector<2>(2, 1.0, std::sqrt(3) / 2.);
 
 		translations.push_back(Vector<2>(2, -0.5, 1.0));     //  a
@@ -58,6 +64,7 @@ public:
 
 private:
     void init() {
+		name = "square";
 		basis = Vector<2>(2, 1.0, 1.0);
 
 		translations.push_back(Vector<2>(2, 0.0, 1.0));     //  a
@@ -73,6 +80,7 @@ public:
 
 private:
     void init() {
+		name = "cubic";
 		basis = Vector<3>(3, 1.0, 1.0, 1.0);
 
 		translations.push_back(Vector<3>(3, 0.0, 1.0, 0.0));     //  a
@@ -90,6 +98,7 @@ public:
 
 private:
     void init() {
+		name = "hexagonal";
 		basis = Vector<3>(3, 1.0, std::sqrt(3) / 2.0, 1.0);
 
 		translations.push_back(Vector<3>(3, -0.5, 1.0, 0.0));     //  a
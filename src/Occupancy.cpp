@@ -0,0 +1,323 @@
+
+#include "Occupancy.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+
+Occupancy::Cell Occupancy::toCell(Vector<2> point)
+{
+    return Cell((int)std::lround(point.get(0) * 2), (int)std::lround(point.get(1)));
+}
+
+Vector<2> Occupancy::toPoint(Cell cell)
+{
+    return Vector<2>(2, cell.x / 2.0, (double)cell.y);
+}
+
+std::vector<Occupancy::Cell> Occupancy::toCells(const std::vector<Vector<2> > &translations)
+{
+    std::vector<Cell> cells;
+
+    for (size_t i = 0; i < translations.size(); ++i)
+        cells.push_back(toCell(translations[i]));
+
+    return cells;
+}
+
+const std::vector<Occupancy::Cell> &Occupancy::haloOffsets()
+{
+    // Built once, on first use, even if that is on several threads at once
+    static const std::vector<Cell> offsets = []() {
+        std::vector<Cell> cells;
+
+        /* Same test as the linear scan in DLA::closeToSeed, so both agree
+         * exactly on which cells are close to a seed */
+        for (int dy = -2; dy <= 2; ++dy) {
+            for (int dx = -4; dx <= 4; ++dx) {
+                Vector<2> offset = toPoint(Cell(dx, dy));
+
+                if (offset.getMagnitude() < 1.5)
+                    cells.push_back(Cell(dx, dy));
+            }
+        }
+
+        return cells;
+    }();
+
+    return offsets;
+}
+
+Occupancy::Cell Occupancy::snapOffset(Vector<2> offset, bool half_steps)
+{
+    int y = (int)std::lround(offset.get(1));
+
+    if (!half_steps)
+        return Cell(2 * (int)std::lround(offset.get(0)), y);
+
+    /* Nearest half unit, then step towards the exact value if that cell is
+     * on the other sublattice */
+    double exact_x = offset.get(0) * 2;
+    int x = (int)std::lround(exact_x);
+
+    if ((x + y) % 2 != 0)
+        x += exact_x > x ? 1 : -1;
+
+    return Cell(x, y);
+}
+
+
+void OccupancyGrid::resize(int half_width, int half_height)
+{
+    x_offset = half_width * 2;
+    y_offset = half_height;
+
+    cols = 2 * x_offset + 1;
+    rows = 2 * y_offset + 1;
+    words_per_row = (cols + 63) / 64;
+
+    occupied.assign(words_per_row * rows, 0);
+    near.assign(words_per_row * rows, 0);
+}
+
+void OccupancyGrid::add(Vector<2> seed)
+{
+    add(Occupancy::toCell(seed));
+}
+
+void OccupancyGrid::add(Occupancy::Cell cell)
+{
+    /* Grow until the halo of the new seed fits inside the grid */
+    int half_width = getHalfWidth();
+    int half_height = getHalfHeight();
+
+    while (std::abs(cell.x) + 2 > half_width * 2)
+        half_width *= 2;
+    while (std::abs(cell.y) + 1 > half_height)
+        half_height *= 2;
+
+    if (half_width != getHalfWidth() || half_height != getHalfHeight()) {
+        std::vector<Occupancy::Cell> seeds;
+
+        for (int row = 0; row < rows; ++row) {
+            for (size_t word = 0; word < words_per_row; ++word) {
+                uint64_t bits = occupied[row * words_per_row + word];
+
+                for (int bit = 0; bits; ++bit, bits >>= 1)
+                    if (bits & 1)
+                        seeds.push_back(Occupancy::Cell((int)(word * 64) + bit - x_offset,
+                                                        row - y_offset));
+            }
+        }
+
+        resize(half_width, half_height);
+
+        for (size_t i = 0; i < seeds.size(); ++i)
+            add(seeds[i]);
+    }
+
+    const std::vector<Occupancy::Cell> &halo = Occupancy::haloOffsets();
+
+    setBit(occupied, cell.x + x_offset, cell.y + y_offset);
+
+    for (size_t i = 0; i < halo.size(); ++i)
+        setBit(near, cell.x + halo[i].x + x_offset, cell.y + halo[i].y + y_offset);
+}
+
+bool OccupancyGrid::isSeed(Occupancy::Cell cell) const
+{
+    int col = cell.x + x_offset;
+    int row = cell.y + y_offset;
+
+    if (col < 0 || col >= cols || row < 0 || row >= rows)
+        return false;
+
+    return (occupied[(size_t)row * words_per_row + (col >> 6)] >> (col & 63)) & 1;
+}
+
+
+void TiledOccupancy::add(Vector<2> seed)
+{
+    add(Occupancy::toCell(seed));
+}
+
+void TiledOccupancy::add(Occupancy::Cell cell)
+{
+    const std::vector<Occupancy::Cell> &halo = Occupancy::haloOffsets();
+
+    Tile &tile = getTile(tileIndex(cell.x), tileIndex(cell.y));
+    tile.occupied[cell.y & (TILE_SIZE - 1)] |= (uint64_t)1 << (cell.x & (TILE_SIZE - 1));
+
+    /* The halo may spill over into the neighbouring tiles */
+    for (size_t i = 0; i < halo.size(); ++i) {
+        int x = cell.x + halo[i].x;
+        int y = cell.y + halo[i].y;
+
+        Tile &near_tile = getTile(tileIndex(x), tileIndex(y));
+        near_tile.near[y & (TILE_SIZE - 1)] |= (uint64_t)1 << (x & (TILE_SIZE - 1));
+    }
+}
+
+bool TiledOccupancy::isSeed(Occupancy::Cell cell) const
+{
+    const Tile *tile = findTile(tileIndex(cell.x), tileIndex(cell.y));
+
+    if (!tile)
+        return false;
+
+    return (tile->occupied[cell.y & (TILE_SIZE - 1)] >> (cell.x & (TILE_SIZE - 1))) & 1;
+}
+
+TiledOccupancy::Tile &TiledOccupancy::getTile(int tx, int ty)
+{
+    uint64_t key = tileKey(tx, ty);
+    size_t i = findSlot(key);
+
+    if (slots[i].tile != -1)
+        return tiles[slots[i].tile];
+
+    /* Keep the table at most half full, rehashing into one twice the size */
+    if (2 * (tile_count + 1) > slots.size()) {
+        std::vector<Slot> old_slots;
+        old_slots.swap(slots);
+        slots.resize(old_slots.size() * 2);
+
+        for (size_t j = 0; j < old_slots.size(); ++j)
+            if (old_slots[j].tile != -1)
+                slots[findSlot(old_slots[j].key)] = old_slots[j];
+
+        i = findSlot(key);
+    }
+
+    Tile tile = Tile();
+    tiles.push_back(tile);
+
+    slots[i].key = key;
+    slots[i].tile = (int)tile_count++;
+
+    return tiles.back();
+}
+
+
+ConcurrentOccupancy::ConcurrentOccupancy(int radius) : radius(radius)
+{
+    /* Cover the halo of any seed within `radius`, remembering cells are half
+     * a unit wide */
+    half_x = (2 * radius + 2) / TILE_SIZE + 1;
+    half_y = (radius + 1) / TILE_SIZE + 1;
+
+    directory = new std::atomic<Tile *>[(size_t)4 * half_x * half_y]();
+}
+
+ConcurrentOccupancy::~ConcurrentOccupancy()
+{
+    if (!directory)
+        return;
+
+    for (size_t i = 0; i < (size_t)4 * half_x * half_y; ++i)
+        delete directory[i].load();
+
+    delete[] directory;
+}
+
+ConcurrentOccupancy::ConcurrentOccupancy(ConcurrentOccupancy &&other)
+    : radius(other.radius), half_x(other.half_x), half_y(other.half_y), directory(other.directory)
+{
+    other.directory = 0;
+}
+
+ConcurrentOccupancy &ConcurrentOccupancy::operator=(ConcurrentOccupancy &&other)
+{
+    std::swap(radius, other.radius);
+    std::swap(half_x, other.half_x);
+    std::swap(half_y, other.half_y);
+    std::swap(directory, other.directory);
+
+    return *this;
+}
+
+void ConcurrentOccupancy::add(Vector<2> seed)
+{
+    add(Occupancy::toCell(seed));
+}
+
+void ConcurrentOccupancy::add(Occupancy::Cell cell)
+{
+    if (std::abs(cell.x) + 2 > 2 * radius || std::abs(cell.y) + 1 > radius)
+        throw std::out_of_range("seed is outside the concurrent occupancy map");
+
+    const std::vector<Occupancy::Cell> &halo = Occupancy::haloOffsets();
+
+    getTile(cell).occupied[cell.y & (TILE_SIZE - 1)].fetch_or(
+        (uint64_t)1 << (cell.x & (TILE_SIZE - 1)), std::memory_order_relaxed);
+
+    for (size_t i = 0; i < halo.size(); ++i) {
+        Occupancy::Cell near_cell(cell.x + halo[i].x, cell.y + halo[i].y);
+
+        getTile(near_cell).near[near_cell.y & (TILE_SIZE - 1)].fetch_or(
+            (uint64_t)1 << (near_cell.x & (TILE_SIZE - 1)), std::memory_order_relaxed);
+    }
+}
+
+bool ConcurrentOccupancy::isSeed(Occupancy::Cell cell) const
+{
+    const Tile *tile = findTile(cell);
+
+    if (!tile)
+        return false;
+
+    return (tile->occupied[cell.y & (TILE_SIZE - 1)].load(std::memory_order_relaxed)
+            >> (cell.x & (TILE_SIZE - 1))) & 1;
+}
+
+ConcurrentOccupancy::Tile &ConcurrentOccupancy::getTile(Occupancy::Cell cell)
+{
+    std::atomic<Tile *> *slot = findSlot(cell);
+    Tile *tile = slot->load(std::memory_order_relaxed);
+
+    /* Readers only ever see the tile once it has been zeroed */
+    if (!tile) {
+        tile = new Tile();
+        slot->store(tile, std::memory_order_release);
+    }
+
+    return *tile;
+}
+
+
+void OccupancyPyramid::add(Vector<2> seed)
+{
+    add(Occupancy::toCell(seed));
+}
+
+void OccupancyPyramid::add(Occupancy::Cell cell)
+{
+    for (int level = MIN_LEVEL; level <= MAX_LEVEL; ++level) {
+        /* Blocks are twice as many cells wide as they are high, since cells
+         * are half a unit wide */
+        int block_x = Occupancy::floorDiv(cell.x, 2 << level);
+        int block_y = Occupancy::floorDiv(cell.y, 1 << level);
+
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx)
+                levels[level].insert(Occupancy::cellKey(block_x + dx, block_y + dy));
+    }
+}
+
+double OccupancyPyramid::getEmptyRadius(Occupancy::Cell cell) const
+{
+    /* Marked regions only grow with the level, so find the first level at
+     * which the point's block is marked */
+    int level = MIN_LEVEL;
+
+    while (level <= MAX_LEVEL && !levels[level].count(blockKey(cell.x, cell.y, level)))
+        ++level;
+
+    if (level == MIN_LEVEL)
+        return 0;
+
+    /* Every seed is at least 2^(level - 1) units away; leave room for the
+     * 1.5 unit halo and for rounding the landing point onto the lattice */
+    return (double)(1 << (level - 1)) - 3;
+}
@@ -0,0 +1,337 @@
+#ifndef OCCUPANCY_H_
+#define OCCUPANCY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "Vector.h"
+
+/**
+ * Occupancy structures used by the DLAs to answer "is this point close to a
+ * seed?" without scanning every seed.
+ *
+ * Points are quantised onto cells that are half a unit wide in x and one unit
+ * high in y. Every translation of the 2D lattices in Lattice.h (before the
+ * basis is applied) lands on this grid, so the quantisation is exact for any
+ * point a walker can reach.
+ */
+namespace Occupancy {
+    /**
+     * Integer cell coordinates, x in half units and y in whole units. Walkers
+     * step in cells too, so the DLAs' hot paths never touch a double */
+    struct Cell {
+        int x, y;
+
+        Cell() : x(0), y(0) { }
+        Cell(int x, int y) : x(x), y(y) { }
+
+        Cell &operator+=(const Cell &other) { x += other.x; y += other.y; return *this; }
+
+        friend Cell operator+(Cell lhs, const Cell &rhs) { return lhs += rhs; }
+        friend bool operator==(const Cell &lhs, const Cell &rhs) { return lhs.x == rhs.x && lhs.y == rhs.y; }
+        friend bool operator!=(const Cell &lhs, const Cell &rhs) { return !(lhs == rhs); }
+
+        /* Squared distance of the centre from (0, 0), in units */
+        double getSquaredMagnitude() const { return 0.25 * x * x + (double)y * y; }
+    };
+
+    /* Cell containing the (non-basis transformed) point */
+    Cell toCell(Vector<2> point);
+
+    /* Point at the centre of the given cell */
+    Vector<2> toPoint(Cell cell);
+
+    /* Each of the (non-basis transformed) translations as a cell offset */
+    std::vector<Cell> toCells(const std::vector<Vector<2> > &translations);
+
+    /**
+     * Offsets (in cells) of every cell whose centre is closer than 1.5 units
+     * to the centre of the cell (0, 0), i.e. the "halo" that DLA::closeToSeed
+     * considers close to a seed */
+    const std::vector<Cell> &haloOffsets();
+
+    /* Integer division rounding towards -inf */
+    inline int floorDiv(int x, int d) { return (x >= 0 ? x : x - (d - 1)) / d; }
+
+    /* Pack a pair of cell, tile or block coordinates into a single hash key */
+    inline uint64_t cellKey(int x, int y) {
+        return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+    }
+
+    /**
+     * Round an offset to the nearest cell a walker could actually reach from
+     * where it is. On lattices with half steps in x (triangular) the cells
+     * with odd x + y are on the other sublattice, so that parity has to be
+     * kept; otherwise x has to stay a whole number of units. The rounding
+     * moves the offset by less than 0.75 units either way.
+     */
+    Cell snapOffset(Vector<2> offset, bool half_steps);
+}
+
+/**
+ * Dense bit-packed occupancy grid centred on (0, 0).
+ *
+ * Keeps two bit planes: one marking the cells holding a seed, and one marking
+ * every cell within the halo of a seed, so that a sticking test is a single
+ * bit lookup however many seeds there are. The grid doubles in size (and is
+ * rebuilt from the seed plane) whenever a seed's halo would fall outside it.
+ */
+class OccupancyGrid {
+public:
+    OccupancyGrid() { resize(64, 64); }
+    OccupancyGrid(int half_width, int half_height) { resize(half_width, half_height); }
+
+    /* Mark the cell containing `seed` as a seed and its halo as near a seed */
+    void add(Vector<2> seed);
+    void add(Occupancy::Cell cell);
+
+    /* Return true if the point is within the halo of any seed */
+    bool isNearSeed(Vector<2> point) const { return isNearSeed(Occupancy::toCell(point)); }
+
+    bool isNearSeed(Occupancy::Cell cell) const {
+        int col = cell.x + x_offset;
+        int row = cell.y + y_offset;
+
+        if (col < 0 || col >= cols || row < 0 || row >= rows)
+            return false;
+
+        return (near[(size_t)row * words_per_row + (col >> 6)] >> (col & 63)) & 1;
+    }
+
+    /* Return true if the point holds a seed */
+    bool isSeed(Occupancy::Cell cell) const;
+
+    /* Half width and half height of the grid in lattice units */
+    int getHalfWidth() const { return x_offset / 2; }
+    int getHalfHeight() const { return y_offset; }
+
+    /* Bytes used by both bit planes */
+    size_t getMemoryUsage() const { return (occupied.size() + near.size()) * sizeof(uint64_t); }
+
+private:
+    void resize(int half_width, int half_height);
+
+    void setBit(std::vector<uint64_t> &plane, int col, int row) {
+        plane[(size_t)row * words_per_row + (col >> 6)] |= (uint64_t)1 << (col & 63);
+    }
+
+    // Cell (x_offset, y_offset) is the point (0, 0)
+    int x_offset, y_offset;
+    int cols, rows;
+    size_t words_per_row;
+
+    std::vector<uint64_t> occupied;
+    std::vector<uint64_t> near;
+};
+
+/**
+ * Sparse occupancy map made of 64x64 cell bitmap tiles, allocated only when a
+ * seed's halo touches them.
+ *
+ * Unlike OccupancyGrid there is no bounding box to grow, so memory depends on
+ * the area the cluster actually covers rather than on how far it reaches.
+ * Tiles are found through an open addressing hash table keyed by tile
+ * coordinate.
+ */
+class TiledOccupancy {
+public:
+    TiledOccupancy() : tile_count(0) { slots.resize(64); }
+
+    /* Mark the cell containing `seed` as a seed and its halo as near a seed */
+    void add(Vector<2> seed);
+    void add(Occupancy::Cell cell);
+
+    /* Return true if the point is within the halo of any seed */
+    bool isNearSeed(Vector<2> point) const { return isNearSeed(Occupancy::toCell(point)); }
+
+    bool isNearSeed(Occupancy::Cell cell) const {
+        const Tile *tile = findTile(tileIndex(cell.x), tileIndex(cell.y));
+
+        if (!tile)
+            return false;
+
+        return (tile->near[cell.y & (TILE_SIZE - 1)] >> (cell.x & (TILE_SIZE - 1))) & 1;
+    }
+
+    /* Return true if the point holds a seed */
+    bool isSeed(Occupancy::Cell cell) const;
+
+    /* Number of tiles allocated so far */
+    size_t getTileCount() const { return tile_count; }
+
+    /* Bytes used by the tiles and the hash table */
+    size_t getMemoryUsage() const { return tiles.size() * sizeof(Tile) + slots.size() * sizeof(Slot); }
+
+    // Cells along each side of a tile, one 64-bit word per row
+    static const int TILE_SIZE = 64;
+
+private:
+    struct Tile {
+        uint64_t occupied[TILE_SIZE];
+        uint64_t near[TILE_SIZE];
+    };
+
+    struct Slot {
+        uint64_t key;
+        int tile; // index into tiles, or -1 if the slot is empty
+
+        Slot() : key(0), tile(-1) { }
+    };
+
+    /* Tile coordinate containing cell coordinate `x` */
+    static int tileIndex(int x) { return Occupancy::floorDiv(x, TILE_SIZE); }
+
+    static uint64_t tileKey(int tx, int ty) { return Occupancy::cellKey(tx, ty); }
+
+    /* Index of the slot holding the key, or of the empty slot it would go in */
+    size_t findSlot(uint64_t key) const {
+        size_t mask = slots.size() - 1;
+        size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+
+        while (slots[i].tile != -1 && slots[i].key != key)
+            i = (i + 1) & mask;
+
+        return i;
+    }
+
+    const Tile *findTile(int tx, int ty) const {
+        const Slot &slot = slots[findSlot(tileKey(tx, ty))];
+        return slot.tile == -1 ? 0 : &tiles[slot.tile];
+    }
+
+    /* Find the tile, allocating it if needed */
+    Tile &getTile(int tx, int ty);
+
+    std::vector<Tile> tiles;
+    std::vector<Slot> slots; // size is always a power of two
+    size_t tile_count;
+};
+
+/**
+ * Tiled occupancy map that walkers on other threads can read while seeds are
+ * being added.
+ *
+ * Tiles are looked up in a fixed directory covering a square of the given
+ * radius around (0, 0), so no lookup ever has to wait for a table to be
+ * rehashed. Tiles are published with release/acquire ordering and their bits
+ * are set atomically, so a reader either sees a seed's halo or doesn't yet,
+ * but never a half-built tile. Only one thread may call add() at a time.
+ */
+class ConcurrentOccupancy {
+public:
+    ConcurrentOccupancy() : radius(0), half_x(0), half_y(0), directory(0) { }
+    explicit ConcurrentOccupancy(int radius);
+    ~ConcurrentOccupancy();
+
+    ConcurrentOccupancy(ConcurrentOccupancy &&other);
+    ConcurrentOccupancy &operator=(ConcurrentOccupancy &&other);
+
+    /**
+     * Mark the cell containing `seed` as a seed and its halo as near a seed.
+     * Throws out_of_range if the halo isn't inside the radius */
+    void add(Vector<2> seed);
+    void add(Occupancy::Cell cell);
+
+    /* Return true if the point is within the halo of any seed added so far */
+    bool isNearSeed(Vector<2> point) const { return isNearSeed(Occupancy::toCell(point)); }
+
+    bool isNearSeed(Occupancy::Cell cell) const {
+        const Tile *tile = findTile(cell);
+
+        if (!tile)
+            return false;
+
+        return (tile->near[cell.y & (TILE_SIZE - 1)].load(std::memory_order_relaxed)
+                >> (cell.x & (TILE_SIZE - 1))) & 1;
+    }
+
+    /* Return true if the point holds a seed */
+    bool isSeed(Occupancy::Cell cell) const;
+
+    /* Distance from (0, 0) in lattice units that the map is guaranteed to cover */
+    int getRadius() const { return radius; }
+
+    // Radius covered when none is given
+    static const int DEFAULT_RADIUS = 1 << 14;
+
+    static const int TILE_SIZE = 64;
+
+private:
+    ConcurrentOccupancy(const ConcurrentOccupancy &);
+    ConcurrentOccupancy &operator=(const ConcurrentOccupancy &);
+
+    struct Tile {
+        std::atomic<uint64_t> occupied[TILE_SIZE];
+        std::atomic<uint64_t> near[TILE_SIZE];
+    };
+
+    /* Directory entry for the tile containing the cell, or 0 if out of range */
+    std::atomic<Tile *> *findSlot(Occupancy::Cell cell) const {
+        int tx = Occupancy::floorDiv(cell.x, TILE_SIZE) + half_x;
+        int ty = Occupancy::floorDiv(cell.y, TILE_SIZE) + half_y;
+
+        if (tx < 0 || tx >= 2 * half_x || ty < 0 || ty >= 2 * half_y)
+            return 0;
+
+        return &directory[(size_t)ty * 2 * half_x + tx];
+    }
+
+    const Tile *findTile(Occupancy::Cell cell) const {
+        std::atomic<Tile *> *slot = findSlot(cell);
+        return slot ? slot->load(std::memory_order_acquire) : 0;
+    }
+
+    /* Find the tile, allocating and publishing it if needed */
+    Tile &getTile(Occupancy::Cell cell);
+
+    int radius;
+    // Tiles either side of (0, 0) in each direction
+    int half_x, half_y;
+    std::atomic<Tile *> *directory;
+};
+
+/**
+ * Multi-resolution occupancy pyramid used to let walkers take long jumps
+ * through empty space.
+ *
+ * Level k splits the plane into square blocks 2^k units on a side. Adding a
+ * seed marks the block containing it, and the 8 blocks around that one, on
+ * every level. If the block containing a point is unmarked at level k then no
+ * seed is within 2^k units of it (in either direction), so a walker there can
+ * be moved straight onto a circle of slightly smaller radius: a continuous
+ * walk would have to cross that circle before it could get near a seed.
+ */
+class OccupancyPyramid {
+public:
+    OccupancyPyramid() : levels(MAX_LEVEL + 1) { }
+
+    /* Mark the blocks around `seed` on every level */
+    void add(Vector<2> seed);
+    void add(Occupancy::Cell cell);
+
+    /**
+     * Return the radius of a circle around the point that is clear of every
+     * seed's halo, even after the landing point is rounded with
+     * Occupancy::snapOffset(), or 0 if there isn't one of at least
+     * 2^MIN_LEVEL - 3 units */
+    double getEmptyRadius(Vector<2> point) const { return getEmptyRadius(Occupancy::toCell(point)); }
+    double getEmptyRadius(Occupancy::Cell cell) const;
+
+    // Smallest and largest block sizes (as powers of two) that are tracked
+    static const int MIN_LEVEL = 3;
+    static const int MAX_LEVEL = 24;
+
+private:
+    /* Block containing the cell at the given level, as a hash key */
+    static uint64_t blockKey(int x, int y, int level) {
+        return Occupancy::cellKey(Occupancy::floorDiv(x, 2 << level),
+                                  Occupancy::floorDiv(y, 1 << level));
+    }
+
+    // Marked blocks on each level, levels below MIN_LEVEL are left empty
+    std::vector<std::unordered_set<uint64_t> > levels;
+};
+
+#endif /* OCCUPANCY_H_ */
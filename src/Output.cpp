@@ -0,0 +1,203 @@
+
+#include "Output.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if MAPPED_OUTPUT
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+void OutputBuffer::write(const char *data, size_t n)
+{
+    if (used + n > buffer.size())
+        flush();
+
+    // Too big to buffer at all
+    if (n > buffer.size()) {
+        os.write(data, n);
+        return;
+    }
+
+    std::memcpy(&buffer[used], data, n);
+    used += n;
+}
+
+void OutputBuffer::flush()
+{
+    if (used > 0)
+        os.write(&buffer[0], used);
+
+    used = 0;
+}
+
+#if MAPPED_OUTPUT
+bool MappedOutput::open(const std::string &filename, size_t size)
+{
+    close();
+
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0)
+        return false;
+
+    if (size > 0 && ftruncate(fd, (off_t)size) == 0) {
+        void *mapped = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (mapped != MAP_FAILED)
+            data = (char *)mapped;
+    }
+
+    if (!data) {
+        // Don't leave an empty or half-made file where the output should be
+        ::close(fd);
+        ::unlink(filename.c_str());
+        fd = -1;
+
+        return false;
+    }
+
+    this->size = size;
+    used = 0;
+    released = 0;
+
+    return true;
+}
+
+void MappedOutput::close()
+{
+    if (!data)
+        return;
+
+    munmap(data, size);
+
+    // Anything reserved but never written isn't part of the file
+    if (ftruncate(fd, (off_t)used) != 0)
+        std::perror("ftruncate");
+
+    ::close(fd);
+
+    fd = -1;
+    data = 0;
+    size = used = released = 0;
+}
+
+void MappedOutput::release()
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t end = used / page * page;
+
+    if (end <= released)
+        return;
+
+    /* The pages stay in the page cache until they are written back, so
+     * nothing is lost by dropping them here */
+    msync(data + released, end - released, MS_ASYNC);
+    madvise(data + released, end - released, MADV_DONTNEED);
+
+    released = end;
+}
+#else
+bool MappedOutput::open(const std::string &, size_t)
+{
+    return false;
+}
+
+void MappedOutput::close()
+{
+}
+
+void MappedOutput::release()
+{
+}
+#endif
+
+size_t Format::general(double value, char *out)
+{
+    static const double POWERS_OF_TEN[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+    double magnitude = std::fabs(value);
+
+    /* %g only uses fixed notation for exponents from -4 to 5 (after
+     * rounding), so leave the rest, and zeros and non-finite values, to
+     * snprintf */
+    if (!(magnitude >= 1e-4 && magnitude < 999999.5))
+        return std::snprintf(out, MAX_GENERAL, "%g", value);
+
+    int exponent = (int)std::floor(std::log10(magnitude));
+
+    // log10 may be out by one next to a power of ten
+    if (exponent > 5)
+        exponent = 5;
+
+    double scaled = magnitude * POWERS_OF_TEN[5 - exponent];
+
+    if (scaled < 99999.5 && exponent > -4) {
+        --exponent;
+        scaled = magnitude * POWERS_OF_TEN[5 - exponent];
+    } else if (scaled >= 999999.5) {
+        ++exponent;
+        scaled = magnitude * POWERS_OF_TEN[5 - exponent];
+    }
+
+    /* The scaling is only off by an ulp or so, but printf rounds the exact
+     * value, so anything near a tie has to go to snprintf */
+    double whole = std::floor(scaled);
+    double fraction = scaled - whole;
+
+    if (std::fabs(fraction - 0.5) < 1e-6 || scaled < 99999.5)
+        return std::snprintf(out, MAX_GENERAL, "%g", value);
+
+    long digits = (long)whole + (fraction > 0.5 ? 1 : 0);
+
+    if (digits == 1000000) {
+        digits = 100000;
+        ++exponent;
+    }
+
+    if (exponent > 5)
+        return std::snprintf(out, MAX_GENERAL, "%g", value);
+
+    char significant[6];
+
+    for (int i = 5; i >= 0; --i) {
+        significant[i] = (char)('0' + digits % 10);
+        digits /= 10;
+    }
+
+    // Trailing zeros after the decimal point are dropped
+    int last = 5;
+    while (last > exponent && significant[last] == '0')
+        --last;
+
+    size_t n = 0;
+
+    if (value < 0)
+        out[n++] = '-';
+
+    if (exponent >= 0) {
+        for (int i = 0; i <= exponent; ++i)
+            out[n++] = significant[i];
+
+        if (last > exponent) {
+            out[n++] = '.';
+
+            for (int i = exponent + 1; i <= last; ++i)
+                out[n++] = significant[i];
+        }
+    } else {
+        out[n++] = '0';
+        out[n++] = '.';
+
+        for (int i = 0; i < -exponent - 1; ++i)
+            out[n++] = '0';
+
+        for (int i = 0; i <= last; ++i)
+            out[n++] = significant[i];
+    }
+
+    return n;
+}
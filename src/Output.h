@@ -0,0 +1,138 @@
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Buffered output for writing long walks, so each step costs a few bytes of
+ * copying rather than a trip through the stream.
+ */
+class OutputBuffer {
+public:
+    OutputBuffer(std::ostream &os) : os(os), buffer(DEFAULT_CAPACITY), used(0) { }
+    OutputBuffer(std::ostream &os, size_t capacity) : os(os), buffer(capacity), used(0) { }
+    ~OutputBuffer() { flush(); }
+
+    /**
+     * Return space for at least `n` more characters (at most the capacity),
+     * flushing first if there isn't room. commit() however many were used */
+    char *reserve(size_t n) {
+        if (used + n > buffer.size())
+            flush();
+
+        return &buffer[used];
+    }
+
+    void commit(size_t n) { used += n; }
+
+    void write(const char *data, size_t n);
+    void put(char c) { *reserve(1) = c; commit(1); }
+
+    /* Write everything buffered so far to the stream */
+    void flush();
+
+    // Bytes buffered before writing to the stream
+    static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+private:
+    std::ostream &os;
+    std::vector<char> buffer;
+    size_t used;
+};
+
+// Whether MappedOutput can map files
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_OUTPUT 1
+#else
+#define MAPPED_OUTPUT 0
+#endif
+
+/**
+ * Output written straight into a file mapped into memory, with the same
+ * reserve()/commit() interface as OutputBuffer, for binary walks whose size
+ * is known before they start. Records go straight into the page cache with
+ * no copy through a buffer or a write() call, and the pages already written
+ * are handed back to the kernel every WINDOW_SIZE bytes, so memory use
+ * stays small however big the file is and the kernel writes it back when
+ * it likes.
+ *
+ * Only available where there is mmap() (MAPPED_OUTPUT is 1); elsewhere
+ * open() always fails.
+ */
+class MappedOutput {
+public:
+    MappedOutput() : fd(-1), data(0), size(0), used(0), released(0) { }
+    ~MappedOutput() { close(); }
+
+    /**
+     * Create (or replace) `filename`, `size` bytes long, and map it. Returns
+     * false, leaving no file behind, if the file couldn't be created or
+     * mapped */
+    bool open(const std::string &filename, size_t size);
+
+    /* Truncate the file to what has been written and unmap it */
+    void close();
+
+    bool isOpen() const { return data != 0; }
+
+    /* Throws out_of_range if there aren't `n` more bytes in the file */
+    char *reserve(size_t n) {
+        if (n > size - used)
+            throw std::out_of_range("past the end of the mapped file");
+
+        return data + used;
+    }
+
+    void commit(size_t n) {
+        used += n;
+
+        if (used - released >= WINDOW_SIZE)
+            release();
+    }
+
+    void write(const char *bytes, size_t n) { std::memcpy(reserve(n), bytes, n); commit(n); }
+    void put(char c) { *reserve(1) = c; commit(1); }
+
+    // Bytes written so far
+    size_t tell() const { return used; }
+
+    // Bytes written between handing pages back to the kernel
+    static const size_t WINDOW_SIZE = 1 << 24;
+
+private:
+    /* Start writing back the pages written so far and drop them from this process */
+    void release();
+
+    MappedOutput(const MappedOutput &);
+    MappedOutput &operator=(const MappedOutput &);
+
+    int fd;
+    char *data;
+    size_t size;
+    size_t used;
+
+    // Bytes (a whole number of pages) already handed back
+    size_t released;
+};
+
+namespace Format {
+    // Longest output of general(), including the sign and exponent
+    const size_t MAX_GENERAL = 32;
+
+    /**
+     * Write `value` to `out` exactly as an ostream with the default flags
+     * would (printf's %g with 6 significant digits), without a terminating
+     * null, returning the number of characters. Works the digits out with
+     * integers for the usual case and only falls back to snprintf for
+     * exponents, values too close to a rounding tie to call, and the like.
+     */
+    size_t general(double value, char *out);
+}
+
+#endif /* OUTPUT_H_ */
@@ -0,0 +1,167 @@
+#ifndef PACKEDWALK_H_
+#define PACKEDWALK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "Lattice.h"
+#include "Random.h"
+#include "Vector.h"
+#include "Walk.h"
+
+/**
+ * Random walk on an N-dimensional lattice stored as the index of each step in
+ * the lattice's translation set, packed into a few bits per step (2 for the
+ * square lattice, 3 for the others) instead of a Vector<N> of doubles.
+ *
+ * Steps and positions are decoded on demand. The position is also stored
+ * every CHECKPOINT_INTERVAL steps, so finding any position, or the distance
+ * between any two steps, only decodes a short stretch of the walk.
+ *
+ * Steps are drawn exactly as Walk draws them, so a PackedWalk and a Walk with
+ * the same engine give the same walk.
+ */
+template<unsigned int N, class RNG = Xoshiro256>
+class PackedWalk {
+public:
+    PackedWalk(Lattice<N> lattice)
+    : lattice(lattice), translations(lattice.getTranslationSet()),
+      rng(WalkRNG::getSeed(), WalkRNG::nextStream()) { init(); }
+    PackedWalk(Lattice<N> lattice, RNG rng)
+    : lattice(lattice), translations(lattice.getTranslationSet()), rng(rng) { init(); }
+
+    const Lattice<N> &getLattice() const { return lattice; }
+    RNG &getRNG() { return rng; }
+
+    /* Generate a random walk of `length` steps, replacing the current one */
+    PackedWalk &generate(size_t length) {
+        clear();
+        words.reserve(length / steps_per_word + 1);
+        checkpoints.reserve(length / CHECKPOINT_INTERVAL + 1);
+
+        for (size_t i = 0; i < length; ++i)
+            push_back(rng.below(translations.size()));
+
+        return *this;
+    }
+
+    /* Add one random step to the end of the walk, returning it */
+    Vector<N> step() {
+        size_t index = rng.below(translations.size());
+        push_back(index);
+
+        return translations[index];
+    }
+
+    /* Add the step with translation `index` to the end of the walk */
+    void push_back(size_t index) {
+        size_t slot = length % steps_per_word;
+
+        if (slot == 0)
+            words.push_back(0);
+
+        words.back() |= (uint64_t)index << (slot * bits);
+
+        end += translations[index];
+        ++length;
+
+        if (length % CHECKPOINT_INTERVAL == 0)
+            checkpoints.push_back(end);
+    }
+
+    void clear() {
+        words.clear();
+        checkpoints.assign(1, Vector<N>());
+        end = Vector<N>();
+        length = 0;
+    }
+
+    size_t size() const { return length; }
+
+    /* Index in the translation set of step `i` */
+    size_t getIndex(size_t i) const {
+        return (size_t)(words[i / steps_per_word] >> ((i % steps_per_word) * bits)) & mask;
+    }
+
+    /* Step `i`, without the basis applied, as Walk stores it */
+    Vector<N> operator[](size_t i) const { return translations[getIndex(i)]; }
+
+    /**
+     * Position after the first `i` steps, without the basis applied, so
+     * getPosition(0) is the origin and getPosition(size()) the end. Throws
+     * out_of_range past the end */
+    Vector<N> getPosition(size_t i) const {
+        if (i > length)
+            throw std::out_of_range("position is past the end of the walk");
+
+        if (i == length)
+            return end;
+
+        size_t checkpoint = i / CHECKPOINT_INTERVAL;
+        Vector<N> position = checkpoints[checkpoint];
+
+        for (size_t j = checkpoint * CHECKPOINT_INTERVAL; j < i; ++j)
+            position += translations[getIndex(j)];
+
+        return position;
+    }
+
+    /* Same as Walk::getDistance(), after Walk::applyBasis() */
+    double getDistance() const { return getDistanceBetween(0, length); }
+
+    /* Same as Walk::getDistanceBetween(), after Walk::applyBasis() */
+    double getDistanceBetween(size_t start, size_t end) const {
+        return lattice.applyBasis(getPosition(end) - getPosition(start)).getMagnitude();
+    }
+
+    /* Decode into an ordinary Walk, continuing from the same engine state */
+    Walk<N, RNG> unpack() const {
+        Walk<N, RNG> walk(lattice, rng);
+        walk.reserve(length);
+
+        for (size_t i = 0; i < length; ++i)
+            walk.push_back(translations[getIndex(i)]);
+
+        return walk;
+    }
+
+    /* Bytes allocated for steps and checkpoints */
+    size_t getMemoryUsage() const {
+        return words.capacity() * sizeof(uint64_t) + checkpoints.capacity() * sizeof(Vector<N>);
+    }
+
+    // Steps between stored positions
+    static const size_t CHECKPOINT_INTERVAL = 4096;
+
+private:
+    void init() {
+        bits = 1;
+        while (((size_t)1 << bits) < translations.size())
+            ++bits;
+
+        // Steps never straddle two words, so a few bits of each may be unused
+        steps_per_word = 64 / bits;
+        mask = ((uint64_t)1 << bits) - 1;
+
+        clear();
+    }
+
+    Lattice<N> lattice;
+    std::vector<Vector<N> > translations;
+    RNG rng;
+
+    unsigned int bits;
+    size_t steps_per_word;
+    uint64_t mask;
+
+    std::vector<uint64_t> words;
+    size_t length;
+
+    // Position after every CHECKPOINT_INTERVAL steps, starting at the origin
+    std::vector<Vector<N> > checkpoints;
+    Vector<N> end;
+};
+
+#endif /* PACKEDWALK_H_ */
@@ -0,0 +1,361 @@
+
+#include "ParallelDLA.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+
+// Walkers launch this far outside the furthest seed, like PointDLA
+#define LAUNCH_MARGIN 50
+
+// Steps between checks of whether grow() has finished
+#define DONE_CHECK_INTERVAL 1024
+
+// Paths are recorded within about this many units (plus the halo) of the cluster
+#define FRONTIER_RADIUS 4
+
+// Same as in DLA.cpp
+#define MIN_JUMP_RADIUS 2.0
+#define JUMP_CHECK_INTERVAL 4
+
+void ParallelPointDLA::init()
+{
+    setOccupancyMode(CONCURRENT_TILES);
+    addSeed(Vector<2>(2, 0.0, 0.0));
+}
+
+std::vector<Vector<2> > ParallelPointDLA::grow(size_t count)
+{
+    new_seeds.clear();
+    target = count;
+    done = count == 0;
+    out_of_range = false;
+
+    std::vector<std::thread> workers;
+
+    /* Every worker gets a stream of its own, handed out here so that the
+     * streams don't depend on the order the threads start in */
+    for (int i = 0; i < threads; ++i)
+        workers.push_back(std::thread(&ParallelPointDLA::runWalkers, this,
+                                      Xoshiro256(WalkRNG::getSeed(), WalkRNG::nextStream())));
+
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+
+    if (out_of_range)
+        throw std::out_of_range("cluster has outgrown the concurrent occupancy map");
+
+    std::vector<Vector<2> > result;
+    result.swap(new_seeds);
+    return result;
+}
+
+bool ParallelPointDLA::commit(Vector<2> seed)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (done || isSeed(seed))
+        return false;
+
+    addSeed(seed);
+    new_seeds.push_back(seed);
+
+    if (seed.getMagnitude() > furthest_radius)
+        furthest_radius = seed.getMagnitude();
+
+    if (new_seeds.size() >= target)
+        done = true;
+
+    return true;
+}
+
+void ParallelPointDLA::runWalkers(Xoshiro256 engine)
+{
+    // Walkers step in integer cells, as in DLA::walkUntilStuck()
+    std::vector<Occupancy::Cell> translations = Occupancy::toCells(lattice.getTranslationSet());
+
+    bool half_steps = hasHalfSteps(lattice);
+
+    size_t steps = 0;
+
+    while (!done) {
+        /* Launch on a circle outside the cluster as it is right now */
+        double launch_radius = std::max(getFurthestRadius(), (double)init_radius) + LAUNCH_MARGIN;
+
+        // Leave room for the halo of anything that sticks out on the circle
+        if (launch_radius + 2 > ConcurrentOccupancy::DEFAULT_RADIUS) {
+            out_of_range = true;
+            done = true;
+            return;
+        }
+
+        double angle = engine.uniform() * (2 * M_PI);
+        Occupancy::Cell current(2 * (int)(launch_radius * std::cos(angle)),
+                                (int)(launch_radius * std::sin(angle)));
+
+        for (;;) {
+            if (++steps % DONE_CHECK_INTERVAL == 0 && done)
+                return;
+
+            double r_squared = current.getSquaredMagnitude();
+
+            /* Every seed is within the furthest radius, so far outside it we
+             * can jump most of the way in at once, to within 3 units of it */
+            double furthest_radius = getFurthestRadius();
+            double min_jump_from = furthest_radius + 3 + 2;
+
+            if (r_squared > launch_radius * launch_radius)
+                current = Occupancy::toCell(returnToCircle(Occupancy::toPoint(current), launch_radius,
+                                                           engine.uniform(), half_steps));
+            else if (r_squared >= min_jump_from * min_jump_from)
+                current = Occupancy::toCell(jump(Occupancy::toPoint(current),
+                                                 std::sqrt(r_squared) - furthest_radius - 3,
+                                                 engine.uniform() * (2 * M_PI), half_steps));
+            else
+                current += translations[engine.below(translations.size())];
+
+            if (!closeToSeed(current))
+                continue;
+
+            if (stickiness != 1 && engine.uniform() >= stickiness)
+                continue;
+
+            // Either this walker's seed is in, or its site was taken
+            commit(Occupancy::toPoint(current));
+            break;
+        }
+    }
+}
+
+
+void DeterministicPointDLA::init()
+{
+    batch_size = DEFAULT_BATCH_SIZE;
+    init_radius = 10;
+    furthest_radius = 0;
+    reruns = 0;
+    next_walker = 0;
+    batch_start = 0;
+    batch_tainted = false;
+    generation = 0;
+    running = 0;
+    stopping = false;
+
+    setOccupancyMode(SPARSE_TILES);
+
+    commit(Vector<2>(2, 0.0, 0.0));
+    endBatch();
+}
+
+std::vector<Vector<2> > DeterministicPointDLA::grow(size_t count)
+{
+    std::vector<Vector<2> > result;
+
+    while (result.size() < count) {
+        if (next_walker == batch_start + batch.size()) {
+            endBatch();
+            speculate();
+        }
+
+        Speculation &speculation = batch[next_walker - batch_start];
+
+        bool conflict = batch_tainted;
+
+        for (size_t i = 0; i < speculation.path.size() && !conflict; ++i)
+            conflict = batch_halo.count(speculation.path[i]) != 0;
+
+        // Not `seed`, which is the key of every walker's stream
+        Vector<2> stuck = speculation.seed;
+
+        if (conflict) {
+            stuck = runWalker(next_walker, newSeedMargin(), 0);
+            ++reruns;
+        }
+
+        std::vector<uint64_t>().swap(speculation.path);
+
+        commit(stuck);
+        result.push_back(stuck);
+        ++next_walker;
+    }
+
+    stopWorkers();
+
+    return result;
+}
+
+void DeterministicPointDLA::commit(Vector<2> seed)
+{
+    addSeed(seed);
+    batch_seeds.push_back(seed);
+
+    if (seed.getMagnitude() > furthest_radius)
+        furthest_radius = seed.getMagnitude();
+
+    const std::vector<Occupancy::Cell> &halo = Occupancy::haloOffsets();
+    Occupancy::Cell cell = Occupancy::toCell(seed);
+
+    for (size_t i = 0; i < halo.size(); ++i) {
+        Occupancy::Cell near_cell(cell.x + halo[i].x, cell.y + halo[i].y);
+
+        batch_halo.insert(Occupancy::cellKey(near_cell.x, near_cell.y));
+
+        // A path that went here wouldn't have been recorded
+        if (!frontier.isNearSeed(near_cell))
+            batch_tainted = true;
+    }
+}
+
+void DeterministicPointDLA::endBatch()
+{
+    // Built once, on first use, even if several DLAs are growing at once
+    static const std::vector<Occupancy::Cell> frontier_offsets = []() {
+        std::vector<Occupancy::Cell> cells;
+
+        for (int dy = -FRONTIER_RADIUS; dy <= FRONTIER_RADIUS; ++dy)
+            for (int dx = -2 * FRONTIER_RADIUS; dx <= 2 * FRONTIER_RADIUS; ++dx)
+                if (Occupancy::toPoint(Occupancy::Cell(dx, dy)).getMagnitude() <= FRONTIER_RADIUS)
+                    cells.push_back(Occupancy::Cell(dx, dy));
+
+        return cells;
+    }();
+
+    for (size_t i = 0; i < batch_seeds.size(); ++i) {
+        Occupancy::Cell cell = Occupancy::toCell(batch_seeds[i]);
+
+        pyramid.add(cell);
+
+        for (size_t j = 0; j < frontier_offsets.size(); ++j)
+            frontier.add(Occupancy::Cell(cell.x + frontier_offsets[j].x,
+                                         cell.y + frontier_offsets[j].y));
+    }
+
+    batch_seeds.clear();
+    batch_halo.clear();
+    batch_tainted = false;
+}
+
+void DeterministicPointDLA::speculate()
+{
+    batch_start = next_walker;
+    launch_radius = std::max(furthest_radius, (double)init_radius) + LAUNCH_MARGIN;
+
+    batch.assign(batch_size, Speculation());
+    next_speculation = 0;
+
+    std::unique_lock<std::mutex> guard(lock);
+
+    for (int i = (int)workers.size(); i < std::max(threads, 1); ++i)
+        workers.push_back(std::thread(&DeterministicPointDLA::runSpeculations, this, generation + 1));
+
+    running = (int)workers.size();
+    ++generation;
+    batch_ready.notify_all();
+
+    batch_done.wait(guard, [this]() { return running == 0; });
+}
+
+void DeterministicPointDLA::runSpeculations(uint64_t awaited)
+{
+    for (;; ++awaited) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            batch_ready.wait(guard, [this, awaited]() { return stopping || generation == awaited; });
+
+            if (stopping)
+                return;
+        }
+
+        /* Hand out walkers to whichever thread is free; which thread runs
+         * which walker makes no difference to the result */
+        for (size_t j = next_speculation++; j < batch.size(); j = next_speculation++)
+            batch[j].seed = runWalker(batch_start + j, newSeedMargin(), &batch[j].path);
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        if (--running == 0)
+            batch_done.notify_one();
+    }
+}
+
+void DeterministicPointDLA::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        batch_ready.notify_all();
+    }
+
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+
+    workers.clear();
+    stopping = false;
+}
+
+double DeterministicPointDLA::newSeedMargin()
+{
+    /* While every new seed's halo is inside the frontier, new seeds are within
+     * FRONTIER_RADIUS + 1.5 of an old one. Otherwise all we know is that each
+     * one is within 1.5 of the one before. */
+    if (!batch_tainted)
+        return FRONTIER_RADIUS + 2;
+
+    return 1.5 * batch.size();
+}
+
+Vector<2> DeterministicPointDLA::runWalker(uint64_t id, double new_seed_margin,
+                                           std::vector<uint64_t> *path)
+{
+    Xoshiro256 engine(seed, id);
+
+    std::vector<Occupancy::Cell> translations = Occupancy::toCells(lattice.getTranslationSet());
+
+    bool half_steps = hasHalfSteps(lattice);
+
+    double angle = engine.uniform() * (2 * M_PI);
+    Occupancy::Cell current(2 * (int)(launch_radius * std::cos(angle)),
+                            (int)(launch_radius * std::sin(angle)));
+
+    int steps_until_jump_check = 0;
+
+    for (;;) {
+        double jump_radius = 0;
+
+        if (current.getSquaredMagnitude() > launch_radius * launch_radius) {
+            current = Occupancy::toCell(returnToCircle(Occupancy::toPoint(current), launch_radius,
+                                                       engine.uniform(), half_steps));
+        } else {
+            if (--steps_until_jump_check <= 0) {
+                /* The pyramid doesn't know about seeds from this batch, so
+                 * keep clear of wherever they could be */
+                jump_radius = pyramid.getEmptyRadius(current) - new_seed_margin;
+
+                if (jump_radius < MIN_JUMP_RADIUS) {
+                    jump_radius = 0;
+                    steps_until_jump_check = JUMP_CHECK_INTERVAL;
+                }
+            }
+
+            if (jump_radius > 0)
+                current = Occupancy::toCell(jump(Occupancy::toPoint(current), jump_radius,
+                                                 engine.uniform() * (2 * M_PI), half_steps));
+            else
+                current += translations[engine.below(translations.size())];
+        }
+
+        if (path && frontier.isNearSeed(current))
+            path->push_back(Occupancy::cellKey(current.x, current.y));
+
+        if (!closeToSeed(current))
+            continue;
+
+        if (stickiness != 1 && engine.uniform() >= stickiness)
+            continue;
+
+        return Occupancy::toPoint(current);
+    }
+}
@@ -0,0 +1,211 @@
+#ifndef PARALLELDLA_H_
+#define PARALLELDLA_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "DLA.h"
+#include "Lattice.h"
+#include "Random.h"
+#include "Vector.h"
+
+/**
+ * Point DLA grown by several threads at once, each running its own walker.
+ *
+ * Walkers launch on a circle just outside the cluster, are returned to it
+ * exactly if they wander off (see DLA::returnToCircle()), and jump straight
+ * towards the cluster when they are far outside it. They all read a single
+ * ConcurrentOccupancy without locking, and take a lock only to commit a seed.
+ *
+ * Because walkers read the occupancy while others are committing, a walker
+ * may step through the halo of a seed committed moments before without
+ * noticing, exactly as if the walkers really had moved at the same time. The
+ * only conflict that has to be resolved is two walkers sticking to the same
+ * site: the commit re-checks the site under the lock, and a walker whose site
+ * has already been taken is discarded and a fresh one launched instead. With
+ * many more seeds than walkers in flight the result is statistically the same
+ * as growing the cluster one walker at a time.
+ */
+class ParallelPointDLA : public DLA {
+public:
+    ParallelPointDLA(Lattice<2> lattice, int threads)
+    : DLA(), lattice(lattice), threads(threads), init_radius(10), furthest_radius(0) { init(); }
+    ParallelPointDLA(Lattice<2> lattice, int threads, double stickiness)
+    : DLA(stickiness), lattice(lattice), threads(threads), init_radius(10), furthest_radius(0) { init(); }
+
+    int getThreads() { return threads; }
+    void setThreads(int threads) { this->threads = threads; }
+
+    /* Same as PointDLA::getFurthestRadius() */
+    double getFurthestRadius() { return furthest_radius.load(); }
+
+    /**
+     * Run walkers on getThreads() threads until `count` more seeds have
+     * stuck, returning the new seeds in the order they were committed.
+     * Throws out_of_range if the cluster outgrows the occupancy map */
+    std::vector<Vector<2> > grow(size_t count);
+
+private:
+    /* Add the initial seed at (0, 0) */
+    void init();
+
+    /* Run walkers one after another until `grow` has enough seeds */
+    void runWalkers(Xoshiro256 engine);
+
+    /**
+     * Try to commit the seed under the lock. Returns false if the site was
+     * already taken or enough seeds have been committed */
+    bool commit(Vector<2> seed);
+
+    Lattice<2> lattice;
+    int threads;
+    int init_radius;
+
+    std::atomic<double> furthest_radius;
+
+    // State of the current call to grow(), guarded by `lock`
+    std::mutex lock;
+    std::vector<Vector<2> > new_seeds;
+    size_t target;
+
+    std::atomic<bool> done;
+    std::atomic<bool> out_of_range;
+};
+
+/**
+ * Point DLA grown on several threads that gives exactly the same cluster for
+ * a given seed however many threads it uses.
+ *
+ * Walker n draws all its random numbers from its own stream, keyed by the
+ * seed and n, and becomes seed n + 1 of the cluster. Walkers are run in
+ * batches: every walker in a batch is simulated speculatively, in parallel,
+ * against the cluster as it was at the start of the batch, recording the
+ * cells it visited near the cluster. Their seeds are then committed one at a
+ * time in walker order. A walker whose path touched the halo of a seed
+ * committed earlier in the same batch might have stuck somewhere else, so it
+ * is re-run from the start of its stream against the cluster as it is now,
+ * which is exactly what a serial run would have done.
+ *
+ * Paths are only recorded within a few units of the cluster (the "frontier"),
+ * since new seeds nearly always stick right next to old ones. If one doesn't,
+ * and its halo reaches outside the frontier, every remaining walker in the
+ * batch is re-run rather than trusting its incomplete path.
+ *
+ * Everything a walker does apart from sticking (where it launches, when it
+ * jumps and how far) depends only on its stream and the state at the start of
+ * the batch, so paths that don't touch a new halo are unaffected by the new
+ * seeds. The result depends on the seed and the batch size, never on the
+ * number of threads or on how the seeds are asked for.
+ */
+class DeterministicPointDLA : public DLA {
+public:
+    DeterministicPointDLA(Lattice<2> lattice, int threads, uint64_t seed)
+    : DLA(), lattice(lattice), threads(threads), seed(seed) { init(); }
+    DeterministicPointDLA(Lattice<2> lattice, int threads, uint64_t seed, double stickiness)
+    : DLA(stickiness), lattice(lattice), threads(threads), seed(seed) { init(); }
+
+    int getThreads() { return threads; }
+    void setThreads(int threads) { this->threads = threads; }
+
+    /* Walkers simulated speculatively at once. Changing it changes the cluster */
+    size_t getBatchSize() { return batch_size; }
+    void setBatchSize(size_t batch_size) { this->batch_size = batch_size; }
+
+    /* Same as PointDLA::getFurthestRadius() */
+    double getFurthestRadius() { return furthest_radius; }
+
+    /* Number of walkers that have had to be re-run after a conflict */
+    size_t getReruns() { return reruns; }
+
+    /**
+     * Commit `count` more seeds, returning them in order. Speculation for a
+     * batch that isn't used up is kept for the next call, so the cluster
+     * doesn't depend on how the seeds are asked for either */
+    std::vector<Vector<2> > grow(size_t count);
+
+    // Walkers in a batch unless setBatchSize() is called
+    static const size_t DEFAULT_BATCH_SIZE = 32;
+
+private:
+    /* A walker's speculative seed, and the cells it visited near the cluster */
+    struct Speculation {
+        Vector<2> seed;
+        std::vector<uint64_t> path;
+    };
+
+    /* Add the initial seed at (0, 0) */
+    void init();
+
+    /* Simulate every walker in the next batch in parallel */
+    void speculate();
+
+    /**
+     * Speculate on walkers from each batch speculate() hands out, starting
+     * with batch number `awaited`, until stopWorkers() */
+    void runSpeculations(uint64_t awaited);
+
+    /* Let the workers finish and join them */
+    void stopWorkers();
+
+    /* Commit the seed, adding its halo to the cells conflicts are checked against */
+    void commit(Vector<2> seed);
+
+    /* Bring the pyramid and frontier up to date with the last batch's seeds */
+    void endBatch();
+
+    /**
+     * How far from the cluster at the start of the batch the seeds committed
+     * so far in the batch could be. Walkers never jump closer than this */
+    double newSeedMargin();
+
+    /**
+     * Run walker `id` from the start of its stream until it sticks to the
+     * current cluster, keeping `new_seed_margin` from it when jumping, and
+     * recording the cells it visits near the cluster in `path` if it isn't 0 */
+    Vector<2> runWalker(uint64_t id, double new_seed_margin, std::vector<uint64_t> *path);
+
+    Lattice<2> lattice;
+    int threads;
+    uint64_t seed;
+    size_t batch_size;
+    int init_radius;
+    double furthest_radius;
+    size_t reruns;
+
+    // Id of the next walker to commit
+    uint64_t next_walker;
+
+    // The current batch, starting at walker batch_start
+    uint64_t batch_start;
+    std::vector<Speculation> batch;
+    std::unordered_set<uint64_t> batch_halo;
+
+    // Set once a seed's halo has left the frontier, so paths can't be trusted
+    bool batch_tainted;
+
+    double launch_radius;
+
+    /* Workers for speculate(), started by the first batch of a call to
+     * grow() and kept until it returns. `lock` guards the rest */
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable batch_ready, batch_done;
+    uint64_t generation;
+    int running;
+    bool stopping;
+
+    // Next walker of the batch to speculate on
+    std::atomic<size_t> next_speculation;
+
+    // Only updated between batches, so jumps are the same in every run
+    OccupancyPyramid pyramid;
+    TiledOccupancy frontier;
+    std::vector<Vector<2> > batch_seeds;
+};
+
+#endif /* PARALLELDLA_H_ */
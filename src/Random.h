@@ -0,0 +1,212 @@
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Random number engines for the walks.
+ *
+ * Any engine with the same interface as Xoshiro256 can be plugged into
+ * Walk<N, RNG>: a (seed, stream) constructor giving an independent stream for
+ * each stream number, next() for raw 64-bit output, below(n) for an index in
+ * [0, n) and uniform() for a double in [0, 1). Engines also satisfy the
+ * standard UniformRandomBitGenerator requirements, so they work with the
+ * <random> distributions.
+ */
+
+/* One step of the splitmix64 generator, used to expand seeds into states */
+inline uint64_t splitmix64(uint64_t &x)
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * xoshiro256++ (Blackman and Vigna): fast, 256 bits of state, and good in
+ * all of its output bits.
+ *
+ * Independent streams come either from keying the constructor with a stream
+ * number (each (seed, stream) pair hashes to an unrelated state), or from
+ * jump(), which moves 2^128 outputs ahead so that consecutive jumps give
+ * non-overlapping sequences.
+ */
+class Xoshiro256 {
+public:
+    typedef uint64_t result_type;
+
+    explicit Xoshiro256(uint64_t seed = 0, uint64_t stream = 0) { setSeed(seed, stream); }
+
+    void setSeed(uint64_t seed, uint64_t stream = 0) {
+        uint64_t x = seed ^ (stream * 0xd1b54a32d192ed03ULL);
+        // Keep streams of the same seed apart even when the xor collides
+        x += splitmix64(stream);
+
+        for (int i = 0; i < 4; ++i)
+            s[i] = splitmix64(x);
+    }
+
+    uint64_t next() {
+        const uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+        const uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+
+        return result;
+    }
+
+    /**
+     * Index in [0, n) from the top 32 bits, by multiplication rather than
+     * modulo. Always uses exactly one output, and the bias for small n is
+     * below n / 2^32 */
+    size_t below(size_t n) { return (size_t)(((next() >> 32) * (uint64_t)n) >> 32); }
+
+    /* Double in [0, 1) with 53 random bits */
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    /* Move 2^128 outputs ahead */
+    void jump() {
+        static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                         0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+        uint64_t t[4] = { 0, 0, 0, 0 };
+
+        for (int i = 0; i < 4; ++i) {
+            for (int b = 0; b < 64; ++b) {
+                if (JUMP[i] & ((uint64_t)1 << b))
+                    for (int j = 0; j < 4; ++j)
+                        t[j] ^= s[j];
+                next();
+            }
+        }
+
+        for (int j = 0; j < 4; ++j)
+            s[j] = t[j];
+    }
+
+    /* UniformRandomBitGenerator interface */
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~(result_type)0; }
+    result_type operator()() { return next(); }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t s[4];
+};
+
+/**
+ * Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+ * 3"): a counter-based generator, where draw i of stream s is a pure function
+ * of (seed, s, i). Slower than Xoshiro256, but any draw can be regenerated
+ * in O(1) with seek(), so a walk drawing one number per step (as
+ * Walk::nextStep() does) can be split across threads or replayed from any
+ * step without storing it.
+ *
+ * Each block of the cipher gives two 64-bit draws. The counter holds the
+ * block number and the stream, and the key is the seed.
+ */
+class Philox4x32 {
+public:
+    typedef uint64_t result_type;
+
+    explicit Philox4x32(uint64_t seed = 0, uint64_t stream = 0) { setSeed(seed, stream); }
+
+    void setSeed(uint64_t seed, uint64_t stream = 0) {
+        key[0] = (uint32_t)seed;
+        key[1] = (uint32_t)(seed >> 32);
+        this->stream = stream;
+        index = 0;
+    }
+
+    /* Draw number `i` of the stream, without moving it */
+    uint64_t draw(uint64_t i) const {
+        uint32_t out[4];
+        block(i >> 1, out);
+
+        return (i & 1) ? join(out[2], out[3]) : join(out[0], out[1]);
+    }
+
+    uint64_t next() {
+        if ((index & 1) == 0)
+            block(index >> 1, buffer);
+
+        uint64_t result = (index & 1) ? join(buffer[2], buffer[3]) : join(buffer[0], buffer[1]);
+        ++index;
+
+        return result;
+    }
+
+    /* Make draw number `i` the next one */
+    void seek(uint64_t i) {
+        index = i;
+
+        if (index & 1)
+            block(index >> 1, buffer);
+    }
+
+    /* Number of the next draw */
+    uint64_t tell() const { return index; }
+
+    /* Same as Xoshiro256::below() */
+    size_t below(size_t n) { return (size_t)(((next() >> 32) * (uint64_t)n) >> 32); }
+
+    /* Same as Xoshiro256::uniform() */
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    /**
+     * The bare cipher: encrypt the counter `in` with `key` into `out`, as in
+     * the reference implementation (so it can be checked against its test
+     * vectors) */
+    static void encrypt(const uint32_t in[4], const uint32_t key[2], uint32_t out[4]) {
+        uint32_t x[4] = { in[0], in[1], in[2], in[3] };
+        uint32_t k0 = key[0], k1 = key[1];
+
+        for (int round = 0; round < 10; ++round) {
+            uint64_t p0 = (uint64_t)0xd2511f53 * x[0];
+            uint64_t p1 = (uint64_t)0xcd9e8d57 * x[2];
+
+            uint32_t y[4] = { (uint32_t)(p1 >> 32) ^ x[1] ^ k0, (uint32_t)p1,
+                              (uint32_t)(p0 >> 32) ^ x[3] ^ k1, (uint32_t)p0 };
+
+            for (int i = 0; i < 4; ++i)
+                x[i] = y[i];
+
+            k0 += 0x9e3779b9;
+            k1 += 0xbb67ae85;
+        }
+
+        for (int i = 0; i < 4; ++i)
+            out[i] = x[i];
+    }
+
+    /* UniformRandomBitGenerator interface */
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~(result_type)0; }
+    result_type operator()() { return next(); }
+
+private:
+    static uint64_t join(uint32_t lo, uint32_t hi) { return (uint64_t)hi << 32 | lo; }
+
+    void block(uint64_t n, uint32_t out[4]) const {
+        uint32_t counter[4] = { (uint32_t)n, (uint32_t)(n >> 32),
+                                (uint32_t)stream, (uint32_t)(stream >> 32) };
+        encrypt(counter, key, out);
+    }
+
+    uint32_t key[2];
+    uint64_t stream;
+    uint64_t index;
+
+    // Block holding the draw before `index`, when that is the first of the two
+    uint32_t buffer[4];
+};
+
+#endif /* RANDOM_H_ */
@@ -0,0 +1,61 @@
+#ifndef SPAN_H_
+#define SPAN_H_
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * Read-only view of a run of elements stored somewhere else (usually in a
+ * std::vector), for handing out a walk's positions or a DLA's seeds without
+ * copying them. Like std::span, the view is only valid for as long as the
+ * storage it points into, so it shouldn't be kept across anything that could
+ * reallocate it (such as adding a step or a seed).
+ */
+template<class T>
+class Span {
+public:
+    typedef const T *const_iterator;
+    typedef const T *iterator;
+
+    Span() : first(0), length(0) { }
+    Span(const T *first, size_t length) : first(first), length(length) { }
+    Span(const std::vector<T> &v) : first(v.empty() ? 0 : &v[0]), length(v.size()) { }
+
+    const T *begin() const { return first; }
+    const T *end() const { return first + length; }
+    const T *data() const { return first; }
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    const T &operator[](size_t i) const { return first[i]; }
+
+    /* Throw out_of_range error if i >= size() */
+    const T &at(size_t i) const {
+        if (i >= length)
+            throw std::out_of_range("index is past the end of the span");
+
+        return first[i];
+    }
+
+    const T &front() const { return first[0]; }
+    const T &back() const { return first[length - 1]; }
+
+    /* View of `count` elements from element `start` */
+    Span subspan(size_t start, size_t count) const {
+        if (start > length || count > length - start)
+            throw std::out_of_range("subspan is past the end of the span");
+
+        return Span(first + start, count);
+    }
+
+    /* Copy the elements out, for when a view isn't enough */
+    std::vector<T> toVector() const { return std::vector<T>(begin(), end()); }
+
+private:
+    const T *first;
+    size_t length;
+};
+
+#endif /* SPAN_H_ */
@@ -38,7 +38,7 @@ public:
     /**
      * Get the i-th component of the vector
      * throw out_of_range error if i > N */
-    double get(unsigned int i) {
+    double get(unsigned int i) const {
         if (i >= N)
             throw std::out_of_range("");
         
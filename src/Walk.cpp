@@ -1,4 +1,26 @@
 
 #include "Walk.h"
 
-bool WalkRNG::random_seeded;
+#include <atomic>
+#include <ctime>
+
+namespace {
+    std::atomic<uint64_t> seed((uint64_t)std::time(0));
+    std::atomic<uint64_t> stream(0);
+}
+
+uint64_t WalkRNG::getSeed()
+{
+    return seed;
+}
+
+void WalkRNG::setSeed(uint64_t new_seed)
+{
+    seed = new_seed;
+    stream = 0;
+}
+
+uint64_t WalkRNG::nextStream(uint64_t count)
+{
+    return stream.fetch_add(count);
+}
@@ -1,56 +1,126 @@
 #ifndef WALK_H_
 #define WALK_H_
 
+#include <cstdint>
 #include <iostream>
+#include <random>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "BinaryFormat.h"
 #include "Lattice.h"
+#include "Output.h"
+#include "Random.h"
+#include "Span.h"
 
-// Global used just in this file
+// Seeding shared by every walk that isn't given its own engine
 namespace WalkRNG {
-    // Whether or not we've generated a new random seed since program start
-    extern bool random_seeded;
+    // Seed of every such walk, the time at program start unless set
+    uint64_t getSeed();
+    // Also restarts the streams, so runs with the same seed repeat exactly
+    void setSeed(uint64_t seed);
+    // First of `count` unused streams of the seed; each walk takes its own
+    uint64_t nextStream(uint64_t count = 1);
 };
 
 
-/* Class to perform a random walk on an N-dimensional lattice */
-template<unsigned int N>
+/**
+ * Class to perform a random walk on an N-dimensional lattice, drawing its
+ * steps from an RNG engine (see Random.h)
+ */
+template<unsigned int N, class RNG = Xoshiro256>
 class Walk : public std::vector<Vector<N> > {
 public:
-    Walk(Lattice<N> lattice) : lattice(lattice) {
-        /* If we haven't seeded the RNG yet... */
-        if (!WalkRNG::random_seeded) {
-            std::srand((unsigned int)std::time(0));
-            WalkRNG::random_seeded = true;
-        }
-    }
+    Walk(Lattice<N> lattice)
+    : lattice(lattice), translations(lattice.getTranslationSet()),
+      rng(WalkRNG::getSeed(), WalkRNG::nextStream()) {}
+    Walk(Lattice<N> lattice, RNG rng)
+    : lattice(lattice), translations(lattice.getTranslationSet()), rng(rng) {}
+
+    const Lattice<N> &getLattice() const { return lattice; }
+
+    /* Engine the steps are drawn from, for anything else the walker decides at random */
+    RNG &getRNG() { return rng; }
 
     /**
      * Generate random walk on the lattice of length `length` modifying in place
      * with non-basis transformed vectors and also returning the walk.
      * Clears the current walk.
+     *
+     * On a temporary (like Walk<2>(lattice).generate(n)) the walk is returned
+     * as an rvalue, so it is moved into whatever it initialises rather than
+     * copied, and chains with applyBasis() and accumulateVectors() the same way.
      */
-    Walk<N> &generate(int length) {
+    Walk &generate(int length) & {
         this->clear();
+        index.clear();
+        this->reserve(length);
+
+        for (int i = 0; i < length; ++i)
+            this->push_back(nextStep());
+
+        return *this;
+    }
 
-        /* Get the new translation set for this lattice */
-        std::vector<Vector<N> > translation_set = this->lattice.getTranslationSet();
+    // By value, so a reference to the result never outlives the temporary
+    Walk generate(int length) && { generate(length); return std::move(*this); }
 
-        for (int i = 0; i < length; ++i) {
-            /* Get random index for the translation_set */
-            size_t random_index;
-            random_index = std::rand() % translation_set.size();
+    /**
+     * Draw a walk of `length` steps without storing it, returning only its
+     * end point (without the basis applied). Only counts how often each
+     * translation comes up, so needs no memory and no vector additions per
+     * step. Draws the same steps as generate(length), so the end point is
+     * exactly the sum of the walk that would have given.
+     */
+    Vector<N> generateEnd(long long length) {
+        std::vector<long long> counts(translations.size(), 0);
 
-            /* Get the element */
-            Vector<N> random_element = translation_set.at(random_index);
+        for (long long i = 0; i < length; ++i)
+            ++counts[rng.below(translations.size())];
 
-            /* Add it to the walk */
-            this->push_back(random_element);
+        return sumCounts(counts);
+    }
+
+    /**
+     * Sample the end point of a walk of `length` steps directly, in a time
+     * that doesn't depend on the length. How often each translation comes up
+     * is multinomial, so draw each count in turn from its binomial
+     * distribution given the counts before it. Same distribution as
+     * generateEnd(length), but not the same draws.
+     */
+    Vector<N> sampleEnd(long long length) {
+        std::vector<long long> counts(translations.size(), 0);
+        long long remaining = length;
+
+        for (size_t k = 0; k + 1 < translations.size(); ++k) {
+            std::binomial_distribution<long long> binomial(remaining, 1.0 / (translations.size() - k));
+
+            counts[k] = binomial(rng);
+            remaining -= counts[k];
         }
 
-        return *this;
+        counts.back() = remaining;
+
+        return sumCounts(counts);
+    }
+
+    /**
+     * Regenerate steps `start` to `start + length` (exclusive) of the walk
+     * that starts at the beginning of the engine's stream, replacing the
+     * current walk. Every step takes exactly one draw, so this needs an
+     * engine that can seek to a draw, like Philox4x32.
+     */
+    Walk &generateFrom(uint64_t start, int length) & {
+        rng.seek(start);
+
+        return generate(length);
+    }
+
+    Walk generateFrom(uint64_t start, int length) && {
+        generateFrom(start, length);
+        return std::move(*this);
     }
 
     /**
@@ -59,28 +129,46 @@ public:
      * Returns the generated Vector<N>
      */
     Vector<N> step() {
-        std::vector<Vector<N> > translation_set = this->lattice.getTranslationSet();
-
-        size_t random_index = std::rand() % translation_set.size();
-        
-        Vector<N> random_element = translation_set.at(random_index);
+        Vector<N> random_element = nextStep();
 
         this->push_back(random_element);
 
         return random_element;
     }
 
+    /**
+     * Return a random step without adding it to the walk, so walkers that
+     * only need their current position (like the DLAs) use constant memory
+     * however long they run for.
+     */
+    Vector<N> nextStep() {
+        return translations[nextIndex()];
+    }
+
+    /**
+     * Same as nextStep(), but return the index of the step in the lattice's
+     * translation set, for walkers that keep their own table of steps (like
+     * the DLAs, which step in integer cells)
+     */
+    size_t nextIndex() {
+        return rng.below(translations.size());
+    }
+
     /**
      * Apply this->lattice's basis to each vector in the walk
      */
-    Walk &applyBasis() {
+    Walk &applyBasis() & {
         for (size_t i = 0; i < this->size(); ++i) {
             this->at(i) = this->lattice.applyBasis(this->at(i));
         }
 
+        index.clear();
+
         return *this;
     }
 
+    Walk applyBasis() && { applyBasis(); return std::move(*this); }
+
 
     /**
      * Get distance between start and end points of walk
@@ -91,9 +179,13 @@ public:
 
     /**
      * Get distance between inclusive point `start` and
-     * exclusive point `end` of walk
+     * exclusive point `end` of walk. A single subtraction if buildIndex()
+     * has been called since the walk last changed.
      */
     double getDistanceBetween(size_t start, size_t end) {
+        if (hasIndex())
+            return (index[end] - index[start]).getMagnitude();
+
         Vector<N> res;
 
         for (size_t i = start; i < end; ++i) {
@@ -103,13 +195,70 @@ public:
         return res.getMagnitude();
     }
 
+    /**
+     * getDistanceBetween() for each (start, end) pair in `ranges`, building
+     * the index first if it is out of date
+     */
+    std::vector<double> getDistancesBetween(const std::vector<std::pair<size_t, size_t> > &ranges) {
+        if (!hasIndex())
+            buildIndex();
+
+        std::vector<double> distances(ranges.size());
+
+        for (size_t i = 0; i < ranges.size(); ++i)
+            distances[i] = (index[ranges[i].second] - index[ranges[i].first]).getMagnitude();
+
+        return distances;
+    }
+
+    /**
+     * Store the position after every step, so the displacement over any
+     * range of steps is one subtraction. Uses as much memory again as the
+     * walk. generate() and applyBasis() drop the index, and changing the
+     * length of the walk makes it ignored until it is rebuilt, but changing
+     * steps in place through the std::vector interface needs a rebuild.
+     */
+    void buildIndex() {
+        index.assign(1, Vector<N>());
+
+        if (this->empty())
+            return;
+
+        index.reserve(this->size() + 1);
+
+        // Same sums as accumulateVectors(), without building a second walk
+        index.push_back(this->at(0));
+
+        for (size_t i = 1; i < this->size(); ++i)
+            index.push_back(index.back() + this->at(i));
+    }
+
+    /* Whether getDistanceBetween() will use the index */
+    bool hasIndex() const { return index.size() == this->size() + 1; }
+
+    /**
+     * View of the position after each step, the same vectors as
+     * accumulateVectors() gives but without copying the walk, building the
+     * index first if it is out of date. Only valid until the walk or the
+     * index next changes.
+     */
+    Span<Vector<N> > getPositions() {
+        if (!hasIndex())
+            buildIndex();
+
+        return Span<Vector<N> >(index).subspan(1, this->size());
+    }
+
     /**
      * Return new walk with each step added, so each step corresponds to the
-     * current position on the lattice.
+     * current position on the lattice. On a temporary the steps are added up
+     * in place and the walk moved out, rather than copied.
      */
-    Walk<N> accumulateVectors()
+    Walk accumulateVectors() const &
     {
-        Walk<N> walk(this->lattice);
+        Walk walk(this->lattice, rng);
+        walk.reserve(this->size());
+
         Vector<N> running_total = this->at(0);
 
         // Initial value 
@@ -125,6 +274,26 @@ public:
         return walk;
     }
 
+    Walk accumulateVectors() && { return std::move(accumulate()); }
+
+    /**
+     * Same as accumulateVectors(), but replacing each step of this walk with
+     * the position after it, so no second walk is needed
+     */
+    Walk &accumulate() {
+        // Throw on an empty walk, as accumulateVectors() does
+        Vector<N> running_total = this->at(0);
+
+        for (size_t i = 1; i < this->size(); ++i) {
+            running_total += this->at(i);
+            this->at(i) = running_total;
+        }
+
+        index.clear();
+
+        return *this;
+    }
+
     /**
      * Return as string of newline-seperated comma seperated rows
      * with first column as x-component, second column as y-component, etc.
@@ -135,8 +304,79 @@ public:
         return ss.str();
     }
 
+    /**
+     * Generate a walk of `length` steps and write it to `os` exactly as
+     * generate(length).applyBasis() then toCSV() would, or with each step
+     * accumulated first if `accumulate`, as accumulateVectors().toCSV()
+     * would. Each step is drawn, transformed, added on and formatted in one
+     * go into a fixed-size buffer, so the walk is never stored and memory
+     * doesn't depend on the length. Leaves the current walk as it is.
+     */
+    void writeCSV(std::ostream &os, long long length, bool accumulate) {
+        OutputBuffer out(os);
+
+        std::vector<Vector<N> > applied(translations.size());
+        for (size_t k = 0; k < translations.size(); ++k)
+            applied[k] = lattice.applyBasis(translations[k]);
+
+        if (!accumulate) {
+            // Every line is one of a few, so format those once
+            std::vector<std::string> lines(applied.size());
+
+            for (size_t k = 0; k < applied.size(); ++k) {
+                char line[N * (Format::MAX_GENERAL + 2) + 1];
+                lines[k].assign(line, formatRow(applied[k], line));
+            }
+
+            for (long long i = 0; i < length; ++i) {
+                const std::string &line = lines[nextIndex()];
+                out.write(line.data(), line.size());
+            }
+
+            return;
+        }
+
+        // Started from the first step rather than zero, as accumulateVectors() does
+        Vector<N> running_total;
+
+        for (long long i = 0; i < length; ++i) {
+            if (i == 0)
+                running_total = applied[nextIndex()];
+            else
+                running_total += applied[nextIndex()];
+
+            out.commit(formatRow(running_total, out.reserve(N * (Format::MAX_GENERAL + 2) + 1)));
+        }
+    }
+
+    /**
+     * Same as writeCSV(), but writing each step or position to `out` (an
+     * OutputBuffer or MappedOutput) as a binary record (see Format::Content)
+     * with every digit kept. The header is left to the caller, who knows the
+     * seed.
+     */
+    template<class Output>
+    void writeBinary(Output &out, long long length, bool accumulate) {
+        std::vector<Vector<N> > applied(translations.size());
+        for (size_t k = 0; k < translations.size(); ++k)
+            applied[k] = lattice.applyBasis(translations[k]);
+
+        Vector<N> running_total;
+
+        for (long long i = 0; i < length; ++i) {
+            const Vector<N> &step = applied[nextIndex()];
+
+            if (accumulate) {
+                running_total = i == 0 ? step : running_total + step;
+                out.commit(Format::binary(running_total, out.reserve(8 * N)));
+            } else {
+                out.commit(Format::binary(step, out.reserve(8 * N)));
+            }
+        }
+    }
+
     // Display each vector in walk, one on each line
-    friend std::ostream& operator<<(std::ostream& os, const Walk<N> &walk) {
+    friend std::ostream& operator<<(std::ostream& os, const Walk &walk) {
         for (size_t i = 0; i < walk.size(); ++i)
             os << walk.at(i) << std::endl;
 
@@ -144,7 +384,44 @@ public:
     }
 
 private:
+    /* Sum of each translation times the number of times it was taken */
+    Vector<N> sumCounts(const std::vector<long long> &counts) const {
+        Vector<N> end;
+
+        for (size_t k = 0; k < translations.size(); ++k)
+            for (unsigned int d = 0; d < N; ++d)
+                end.set(d, end.get(d) + counts[k] * translations[k].get(d));
+
+        return end;
+    }
+
+    /* Write `v` to `out` as a line of toCSV(), returning its length */
+    static size_t formatRow(const Vector<N> &v, char *out) {
+        size_t n = 0;
+
+        for (unsigned int d = 0; d < N; ++d) {
+            if (d > 0) {
+                out[n++] = ',';
+                out[n++] = ' ';
+            }
+
+            n += Format::general(v.get(d), out + n);
+        }
+
+        out[n++] = '\n';
+
+        return n;
+    }
+
     Lattice<N> lattice;
+
+    // Copied from the lattice once, so steps never allocate
+    std::vector<Vector<N> > translations;
+
+    // Position after each step, starting from the origin (see buildIndex())
+    std::vector<Vector<N> > index;
+
+    RNG rng;
 };
 
 #endif /* WALK_H_ */
@@ -0,0 +1,69 @@
+
+#include "WalkFile.h"
+
+#include <cstring>
+
+namespace {
+    uint32_t getUint32(const char *p) {
+        uint32_t value = 0;
+
+        for (int i = 3; i >= 0; --i)
+            value = (value << 8) | (uint8_t)p[i];
+
+        return value;
+    }
+
+    uint64_t getUint64(const char *p) {
+        return (uint64_t)getUint32(p + 4) << 32 | getUint32(p);
+    }
+
+    double getDouble(const char *p) {
+        uint64_t bits = getUint64(p);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+
+        return value;
+    }
+}
+
+bool WalkFile::readHeader(std::istream &is, Header &header)
+{
+    char fixed[64];
+
+    if (!is.read(fixed, sizeof(fixed)) || std::memcmp(fixed, "WALKPAK", 8) != 0)
+        return false;
+
+    if (getUint32(fixed + 8) != VERSION)
+        return false;
+
+    header.dimension = getUint32(fixed + 12);
+    header.translation_count = getUint32(fixed + 16);
+    header.bits = getUint32(fixed + 20);
+    header.block_steps = getUint32(fixed + 24);
+    header.lattice = std::string(fixed + 32, Format::NAME_LENGTH).c_str();
+    header.seed = getUint64(fixed + 48);
+    header.length = getUint64(fixed + 56);
+
+    // Sanity checks, so a corrupt header can't ask for absurd allocations
+    if (header.dimension == 0 || header.dimension > 16 || header.translation_count == 0
+        || header.translation_count > 1024 || header.bits == 0 || header.bits > 32
+        || ((uint64_t)1 << header.bits) < header.translation_count
+        || header.block_steps != BLOCK_STEPS)
+        return false;
+
+    std::vector<char> rest(header.getSize() - sizeof(fixed));
+
+    if (!is.read(&rest[0], rest.size()))
+        return false;
+
+    header.basis.resize(header.dimension);
+    header.translations.resize((size_t)header.dimension * header.translation_count);
+
+    for (size_t i = 0; i < header.basis.size(); ++i)
+        header.basis[i] = getDouble(&rest[8 * i]);
+
+    for (size_t i = 0; i < header.translations.size(); ++i)
+        header.translations[i] = getDouble(&rest[8 * (header.basis.size() + i)]);
+
+    return true;
+}
@@ -0,0 +1,402 @@
+#ifndef WALKFILE_H_
+#define WALKFILE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BinaryFormat.h"
+#include "Lattice.h"
+#include "Output.h"
+#include "Vector.h"
+
+/**
+ * Compressed walk files (walkrun --format packed), for archiving long walks.
+ *
+ * A walk is stored as the index of each step in the lattice's translation
+ * set, packed into as few bits as hold every index (2 for the square lattice,
+ * 3 for the others) as PackedWalk does, so steps never straddle two words.
+ * Steps are grouped into blocks of BLOCK_STEPS, each starting with a keyframe
+ * of the position (without the basis applied) before its first step, so any
+ * position is found by reading one block, and the keyframes only cost a few
+ * hundredths of a bit per step.
+ *
+ * Everything is little-endian. The header is:
+ *   bytes 0-7     "WALKPAK" and a null
+ *   8-11          version, VERSION
+ *   12-15         dimension N of the lattice
+ *   16-19         number of translations k
+ *   20-23         bits per step
+ *   24-27         steps per block, BLOCK_STEPS
+ *   28-31         zero
+ *   32-47         name of the lattice, padded with nulls
+ *   48-55         seed the walk was generated with
+ *   56-63         number of steps
+ *   64-           basis of the lattice, N doubles, then the k translations
+ *                 (without the basis applied), N doubles each
+ * Then each block is its keyframe, N doubles, and the 64-bit words holding
+ * its steps; only the last block may hold fewer than BLOCK_STEPS steps.
+ */
+namespace WalkFile {
+    const uint32_t VERSION = 1;
+    const uint32_t BLOCK_STEPS = 4096;
+
+    struct Header {
+        Header() : dimension(0), translation_count(0), bits(0), block_steps(0), seed(0), length(0) { }
+
+        uint32_t dimension, translation_count, bits, block_steps;
+        std::string lattice;
+        uint64_t seed, length;
+
+        // N components, then N for each translation
+        std::vector<double> basis, translations;
+
+        size_t getSize() const { return 64 + 8 * (size_t)dimension * (1 + translation_count); }
+
+        uint32_t getStepsPerWord() const { return 64 / bits; }
+        size_t getWordsPerBlock() const { return (block_steps + getStepsPerWord() - 1) / getStepsPerWord(); }
+        size_t getBlockSize() const { return 8 * (dimension + getWordsPerBlock()); }
+
+        /* Bytes in the whole file, header included */
+        uint64_t getFileSize() const {
+            uint64_t full_blocks = length / block_steps, last_steps = length % block_steps;
+            uint64_t size = getSize() + full_blocks * getBlockSize();
+
+            if (last_steps > 0)
+                size += 8 * (dimension + (last_steps + getStepsPerWord() - 1) / getStepsPerWord());
+
+            return size;
+        }
+    };
+
+    /* Header of a walk of `length` steps on `lattice` */
+    template<unsigned int N>
+    Header makeHeader(const Lattice<N> &lattice, uint64_t seed, uint64_t length) {
+        const std::vector<Vector<N> > &translations = lattice.getTranslationSet();
+        Header header;
+
+        header.dimension = N;
+        header.translation_count = (uint32_t)translations.size();
+        header.bits = 1;
+        while (((size_t)1 << header.bits) < translations.size())
+            ++header.bits;
+        header.block_steps = BLOCK_STEPS;
+        header.lattice = lattice.getName();
+        header.seed = seed;
+        header.length = length;
+
+        for (unsigned int d = 0; d < N; ++d)
+            header.basis.push_back(lattice.getBasis().get(d));
+
+        for (size_t k = 0; k < translations.size(); ++k)
+            for (unsigned int d = 0; d < N; ++d)
+                header.translations.push_back(translations[k].get(d));
+
+        return header;
+    }
+
+    /**
+     * Read a header from the start of `is`, returning false if it isn't the
+     * header of a walk file this version can read */
+    bool readHeader(std::istream &is, Header &header);
+
+    /* Write `header` to `out` */
+    template<class Output>
+    void writeHeader(Output &out, const Header &header) {
+        std::vector<char> bytes(header.getSize(), 0);
+        char *p = &bytes[0];
+
+        std::memcpy(p, "WALKPAK", 7);
+        Format::putUint32(VERSION, p + 8);
+        Format::putUint32(header.dimension, p + 12);
+        Format::putUint32(header.translation_count, p + 16);
+        Format::putUint32(header.bits, p + 20);
+        Format::putUint32(header.block_steps, p + 24);
+        std::memcpy(p + 32, header.lattice.data(), std::min(header.lattice.size(), Format::NAME_LENGTH - 1));
+        Format::putUint64(header.seed, p + 48);
+        Format::putUint64(header.length, p + 56);
+
+        for (size_t i = 0; i < header.basis.size(); ++i)
+            Format::putDouble(header.basis[i], p + 64 + 8 * i);
+
+        for (size_t i = 0; i < header.translations.size(); ++i)
+            Format::putDouble(header.translations[i], p + 64 + 8 * (header.basis.size() + i));
+
+        out.write(p, bytes.size());
+    }
+}
+
+/**
+ * Writes a walk of a length known in advance to an OutputBuffer or
+ * MappedOutput as a walk file, one step index at a time, so the walk is never
+ * stored. Exactly that many steps have to be added for the file to be whole.
+ */
+template<unsigned int N, class Output = OutputBuffer>
+class WalkFileWriter {
+public:
+    /* Writes the header straight away */
+    WalkFileWriter(Output &out, const Lattice<N> &lattice, uint64_t seed, uint64_t length)
+    : out(out), header(WalkFile::makeHeader(lattice, seed, length)),
+      translations(lattice.getTranslationSet()), counts(translations.size(), 0),
+      written(0), word(0), slot(0) {
+        WalkFile::writeHeader(out, header);
+    }
+
+    const WalkFile::Header &getHeader() const { return header; }
+
+    /**
+     * Add the step with translation `index`. Throws out_of_range past the
+     * length given to the constructor */
+    void add(size_t index) {
+        if (written == header.length)
+            throw std::out_of_range("walk is longer than its header says");
+
+        if (written % header.block_steps == 0)
+            startBlock();
+
+        word |= (uint64_t)index << (slot * header.bits);
+        ++counts[index];
+        ++written;
+
+        if (++slot == header.getStepsPerWord() || written % header.block_steps == 0
+            || written == header.length)
+            flushWord();
+    }
+
+    /* Steps added so far */
+    uint64_t size() const { return written; }
+
+private:
+    void startBlock() {
+        /* The position only changes once a block, from how often each
+         * translation came up */
+        for (size_t k = 0; k < translations.size(); ++k) {
+            for (unsigned int d = 0; d < N; ++d)
+                position.set(d, position.get(d) + counts[k] * translations[k].get(d));
+
+            counts[k] = 0;
+        }
+
+        out.commit(Format::binary(position, out.reserve(8 * N)));
+    }
+
+    void flushWord() {
+        Format::putUint64(word, out.reserve(8));
+        out.commit(8);
+
+        word = 0;
+        slot = 0;
+    }
+
+    Output &out;
+    WalkFile::Header header;
+
+    std::vector<Vector<N> > translations;
+
+    // Position at the start of the current block, and the steps since
+    Vector<N> position;
+    std::vector<uint64_t> counts;
+
+    uint64_t written;
+    uint64_t word;
+    uint32_t slot;
+};
+
+/**
+ * Random access to the steps and positions of a walk file, reading one block
+ * at a time, so files far bigger than memory can be read from anywhere.
+ */
+template<unsigned int N>
+class WalkFileReader {
+public:
+    WalkFileReader() : loaded_block(NO_BLOCK) { }
+
+    /**
+     * Open `filename`, returning false if it can't be read or isn't a walk
+     * file of dimension N */
+    bool open(const std::string &filename) {
+        file.close();
+        file.clear();
+        file.open(filename.c_str(), std::ios::binary);
+
+        if (!file || !WalkFile::readHeader(file, header) || header.dimension != N)
+            return false;
+
+        basis = toVector(&header.basis[0]);
+        translations.clear();
+
+        for (uint32_t k = 0; k < header.translation_count; ++k)
+            translations.push_back(toVector(&header.translations[k * N]));
+
+        loaded_block = NO_BLOCK;
+        return true;
+    }
+
+    const WalkFile::Header &getHeader() const { return header; }
+
+    /* Number of steps */
+    uint64_t size() const { return header.length; }
+
+    /**
+     * Index in the translation set of step `i`. Throws out_of_range if the
+     * file holds an index with no translation */
+    size_t getIndex(uint64_t i) {
+        if (i >= header.length)
+            throw std::out_of_range("step is past the end of the walk");
+
+        load(i / header.block_steps);
+
+        uint64_t in_block = i % header.block_steps;
+        uint32_t steps_per_word = header.getStepsPerWord();
+        uint64_t word = words[in_block / steps_per_word];
+
+        size_t index = (size_t)(word >> ((in_block % steps_per_word) * header.bits)) & (((uint64_t)1 << header.bits) - 1);
+
+        if (index >= header.translation_count)
+            throw std::out_of_range("walk file has a step with no translation");
+
+        return index;
+    }
+
+    /* Step `i`, without the basis applied */
+    Vector<N> getStep(uint64_t i) { return translations[getIndex(i)]; }
+
+    /**
+     * Position after the first `i` steps, without the basis applied, so
+     * getPosition(0) is the origin and getPosition(size()) the end */
+    Vector<N> getPosition(uint64_t i) {
+        if (i > header.length)
+            throw std::out_of_range("position is past the end of the walk");
+
+        if (i == 0)
+            return Vector<N>();
+
+        // The end of a full last block is only in that block
+        uint64_t block = (i - 1) / header.block_steps;
+        load(block);
+
+        Vector<N> position = keyframe;
+
+        for (uint64_t j = block * header.block_steps; j < i; ++j)
+            position += translations[getIndex(j)];
+
+        return position;
+    }
+
+    Vector<N> applyBasis(const Vector<N> &v) const { return v * basis; }
+
+    /**
+     * Write steps `start` to `end` (exclusive) with the basis applied, as
+     * Walk::writeCSV() does, or if `accumulate` the position after each one.
+     * Positions are the exact lattice position with the basis applied once,
+     * so may differ in the last digit from -a, which adds up the steps after
+     * applying the basis.
+     */
+    void writeCSV(std::ostream &os, uint64_t start, uint64_t end, bool accumulate) {
+        if (start > end || end > header.length)
+            throw std::out_of_range("steps are past the end of the walk");
+
+        OutputBuffer out(os);
+        Vector<N> position = getPosition(start);
+        char line[N * (Format::MAX_GENERAL + 2) + 1];
+
+        for (uint64_t i = start; i < end; ++i) {
+            const Vector<N> &step = translations[getIndex(i)];
+            position += step;
+
+            Vector<N> row = applyBasis(accumulate ? position : step);
+            size_t n = 0;
+
+            for (unsigned int d = 0; d < N; ++d) {
+                if (d > 0) {
+                    line[n++] = ',';
+                    line[n++] = ' ';
+                }
+
+                n += Format::general(row.get(d), line + n);
+            }
+
+            line[n++] = '\n';
+            out.write(line, n);
+        }
+    }
+
+private:
+    static Vector<N> toVector(const double *components) {
+        Vector<N> v;
+
+        for (unsigned int d = 0; d < N; ++d)
+            v.set(d, components[d]);
+
+        return v;
+    }
+
+    /* Read block `block` into keyframe and words, unless it is already there */
+    void load(uint64_t block) {
+        if (block == loaded_block)
+            return;
+
+        if (header.length == 0 || block > (header.length - 1) / header.block_steps)
+            throw std::out_of_range("step is past the end of the walk");
+
+        uint64_t steps = std::min<uint64_t>(header.block_steps, header.length - block * header.block_steps);
+        size_t word_count = (size_t)((steps + header.getStepsPerWord() - 1) / header.getStepsPerWord());
+
+        std::vector<char> bytes(8 * (N + word_count));
+
+        file.clear();
+        file.seekg((std::streamoff)(header.getSize() + block * header.getBlockSize()));
+
+        if (!file.read(&bytes[0], bytes.size()))
+            throw std::out_of_range("walk file is shorter than its header says");
+
+        keyframe = toVector(decode(&bytes[0], N).data());
+
+        std::vector<uint64_t> raw(word_count);
+        for (size_t w = 0; w < word_count; ++w)
+            raw[w] = getUint64(&bytes[8 * (N + w)]);
+
+        words.swap(raw);
+        loaded_block = block;
+    }
+
+    static uint64_t getUint64(const char *p) {
+        uint64_t value = 0;
+
+        for (int i = 7; i >= 0; --i)
+            value = (value << 8) | (uint8_t)p[i];
+
+        return value;
+    }
+
+    static std::vector<double> decode(const char *p, size_t count) {
+        std::vector<double> values(count);
+
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t bits = getUint64(p + 8 * i);
+            std::memcpy(&values[i], &bits, sizeof(double));
+        }
+
+        return values;
+    }
+
+    static const uint64_t NO_BLOCK = ~(uint64_t)0;
+
+    std::ifstream file;
+    WalkFile::Header header;
+
+    Vector<N> basis;
+    std::vector<Vector<N> > translations;
+
+    uint64_t loaded_block;
+    Vector<N> keyframe;
+    std::vector<uint64_t> words;
+};
+
+#endif /* WALKFILE_H_ */
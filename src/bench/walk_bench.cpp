@@ -0,0 +1,84 @@
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "../BatchWalk.h"
+#include "../Lattice.h"
+#include "../PackedWalk.h"
+#include "../Walk.h"
+
+/* Rough steps per second for the walk engine, run with an optional number of
+ * steps (default 10^7) */
+
+template<unsigned int N, class RNG>
+void benchmark(const char *name, Lattice<N> lattice, long steps)
+{
+    Walk<N, RNG> walk(lattice, RNG(1));
+
+    /* Whole walk at once */
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    walk.generate(steps);
+    double generate_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    /* One step at a time, as the DLAs do */
+    Vector<N> position;
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < steps; ++i)
+        position += walk.nextStep();
+    double step_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << ": generate " << steps / generate_time / 1e6 << " M steps/s, "
+              << "nextStep " << steps / step_time / 1e6 << " M steps/s"
+              << " (end " << position << ")" << std::endl;
+}
+
+template<unsigned int N>
+void benchmarkPacked(const char *name, Lattice<N> lattice, long steps)
+{
+    PackedWalk<N> walk(lattice, Xoshiro256(1));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    walk.generate(steps);
+    double generate_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << " (packed): generate " << steps / generate_time / 1e6 << " M steps/s, "
+              << (double)walk.getMemoryUsage() / steps << " bytes/step"
+              << " (end " << walk.getPosition(walk.size()) << ")" << std::endl;
+}
+
+template<unsigned int N>
+void benchmarkBatch(const char *name, Lattice<N> lattice, long steps)
+{
+    BatchWalk<N> walk(lattice, 1, 0);
+    const unsigned int lanes = 16;
+
+    /* The same number of steps in total, split between the lanes */
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    walk.walk(steps / lanes);
+    double walk_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << " (batch): " << steps / walk_time / 1e6 << " M steps/s"
+              << " (end " << walk.getPosition(0) << ")" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    long steps = argc > 1 ? std::atol(argv[1]) : 10000000;
+
+    benchmark<2, Xoshiro256>("triangular", TriLattice(), steps);
+    benchmark<2, Xoshiro256>("square", SquareLattice(), steps);
+    benchmark<3, Xoshiro256>("simple cubic", SimpleCubic(), steps);
+    benchmark<3, Xoshiro256>("hexagonal", Hexagonal(), steps);
+
+    benchmarkPacked<2>("square", SquareLattice(), steps);
+    benchmarkPacked<3>("simple cubic", SimpleCubic(), steps);
+
+    benchmarkBatch<2>("triangular", TriLattice(), steps);
+    benchmarkBatch<3>("hexagonal", Hexagonal(), steps);
+
+    benchmark<2, Philox4x32>("square (philox)", SquareLattice(), steps);
+    benchmark<3, Philox4x32>("simple cubic (philox)", SimpleCubic(), steps);
+
+    return 0;
+}
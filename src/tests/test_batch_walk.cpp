@@ -0,0 +1,79 @@
+#include <catch2/catch_all.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+#include "../BatchWalk.h"
+#include "../Lattice.h"
+
+TEST_CASE( "batch walks take independent lattice steps", "[BatchWalk]" ) {
+    const long long length = 1001;
+
+    BatchWalk<2, 8> batch(SquareLattice(), 1, 0);
+    std::vector<int32_t> trajectory(length * 2 * 8);
+
+    batch.walk(length, &trajectory[0]);
+
+    for (unsigned int lane = 0; lane < 8; ++lane) {
+        int32_t x = 0, y = 0;
+
+        // Every step moves exactly one unit (two half units) along one axis
+        for (long long i = 0; i < length; ++i) {
+            int32_t next_x = trajectory[(i * 2 + 0) * 8 + lane];
+            int32_t next_y = trajectory[(i * 2 + 1) * 8 + lane];
+
+            REQUIRE( std::abs(next_x - x) + std::abs(next_y - y) == 2 );
+
+            x = next_x;
+            y = next_y;
+        }
+
+        REQUIRE( batch.getCoordinates(0)[lane] == x );
+        REQUIRE( batch.getCoordinates(1)[lane] == y );
+        REQUIRE( batch.getPosition(lane) == Vector<2>(2, x / 2.0, y / 2.0) );
+    }
+
+    // The same seed and streams give the same walks
+    BatchWalk<2, 8> again(SquareLattice(), 1, 0);
+    again.walk(length);
+
+    for (unsigned int lane = 0; lane < 8; ++lane)
+        REQUIRE( again.getPosition(lane) == batch.getPosition(lane) );
+
+    // The next streams give different ones
+    BatchWalk<2, 8> other(SquareLattice(), 1, 8);
+    other.walk(length);
+
+    REQUIRE( !(other.getPosition(0) == batch.getPosition(0)) );
+
+    // Seed C with stream 0 and seed 0 with stream 1 have the same seed ^ stream * C
+    const uint64_t C = 0xd1b54a32d192ed03ULL;
+    BatchWalk<2, 8> first(SquareLattice(), C, 0);
+    BatchWalk<2, 8> second(SquareLattice(), 0, 1);
+    first.walk(length);
+    second.walk(length);
+
+    REQUIRE( !(first.getPosition(0) == second.getPosition(0)) );
+}
+
+TEST_CASE( "batch walks spread like random walks", "[BatchWalk]" ) {
+    BatchWalk<3> batch(Hexagonal(), 5, 0);
+    const long long length = 10000;
+    const int batches = 200;
+    double mean_square = 0;
+
+    for (int i = 0; i < batches; ++i) {
+        batch.reset();
+        batch.walk(length);
+
+        for (unsigned int lane = 0; lane < batch.getLanes(); ++lane) {
+            double distance = batch.getDistance(lane);
+            mean_square += distance * distance / length / (batches * batch.getLanes());
+        }
+    }
+
+    // Every hexagonal step has unit length, so <R^2> = length; the estimate
+    // has a standard deviation of about 0.02
+    REQUIRE( mean_square > 0.9 );
+    REQUIRE( mean_square < 1.1 );
+}
@@ -0,0 +1,109 @@
+#include <catch2/catch_all.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include "../DLA.h"
+#include "../Lattice.h"
+#include "../Occupancy.h"
+#include "../ParallelDLA.h"
+#include "../Random.h"
+#include "../Vector.h"
+#include "../Walk.h"
+
+/* Makes DLA's protected helpers callable */
+class DLAProbe : public DLA {
+public:
+    using DLA::returnToCircle;
+};
+
+TEST_CASE( "walkers return to the circle with the harmonic measure", "[DLA]" ) {
+    // Starting cell, radius of the circle, and whether there are half steps
+    struct Case { int x, y; double radius; bool half_steps; };
+    const Case cases[] = { { 120, 80, 50, false },     // (60, 80), r = 100, rho = 1/2
+                           { 120, 80, 50, true },
+                           { -240, -160, 30, true } }; // (-120, -160), r = 200, rho = 3/20
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        Vector<2> from = Occupancy::toPoint(Occupancy::Cell(cases[c].x, cases[c].y));
+        double radius = cases[c].radius;
+        double rho = radius / from.getMagnitude();
+        double from_angle = std::atan2(from.get(1), from.get(0));
+
+        Xoshiro256 rng(31);
+        const int draws = 200000;
+        double sum_cos = 0, sum_sin = 0;
+
+        for (int i = 0; i < draws; ++i) {
+            Vector<2> point = DLAProbe::returnToCircle(from, radius, rng.uniform(), cases[c].half_steps);
+            Occupancy::Cell cell = Occupancy::toCell(point);
+
+            // On the lattice, on the walker's sublattice, and just inside the circle
+            REQUIRE( Occupancy::toPoint(cell) == point );
+            if (cases[c].half_steps)
+                REQUIRE( (cell.x + cell.y) % 2 == 0 );
+            else
+                REQUIRE( cell.x % 2 == 0 );
+
+            REQUIRE( point.getMagnitude() < radius );
+            REQUIRE( point.getMagnitude() > radius - 2 );
+
+            double angle = std::atan2(point.get(1), point.get(0)) - from_angle;
+            sum_cos += std::cos(angle);
+            sum_sin += std::sin(angle);
+        }
+
+        /* The wrapped Cauchy distribution around the direction of `from` has
+         * <cos> = rho and <sin> = 0; the estimates have a standard deviation
+         * of under 0.002 */
+        REQUIRE( std::abs(sum_cos / draws - rho) < 0.01 );
+        REQUIRE( std::abs(sum_sin / draws) < 0.01 );
+    }
+}
+
+/* Record what a DLA's observers are told, checking it against the DLA */
+struct SeedRecorder {
+    std::vector<Vector<2> > seeds;
+    std::vector<size_t> counts;
+
+    void watch(DLA &dla) {
+        dla.addSeedObserver([this](const Vector<2> &seed, size_t count) {
+            seeds.push_back(seed);
+            counts.push_back(count);
+        });
+    }
+
+    void check(const DLA &dla) {
+        // Everything after the initial seed, in the order it was added
+        REQUIRE( seeds.size() == dla.getSeedCount() - 1 );
+        REQUIRE( dla.getSeedView().subspan(1, seeds.size()).toVector() == seeds );
+
+        for (size_t i = 0; i < counts.size(); ++i)
+            REQUIRE( counts[i] == i + 2 );
+    }
+};
+
+TEST_CASE( "seed observers see every seed in the order it's added", "[DLA]" ) {
+    SeedRecorder recorder;
+
+    SECTION( "a point DLA" ) {
+        PointDLA dla(1.0);
+        recorder.watch(dla);
+
+        Walk<2> walk(TriLattice(), Xoshiro256(5));
+
+        while (dla.getSeedCount() < 60)
+            dla.simulateInRadius(walk);
+
+        recorder.check(dla);
+    }
+
+    SECTION( "a parallel point DLA, whose seeds are added by its workers" ) {
+        ParallelPointDLA dla(TriLattice(), 4, 1.0);
+        recorder.watch(dla);
+
+        dla.grow(200);
+
+        recorder.check(dla);
+    }
+}
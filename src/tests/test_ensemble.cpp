@@ -0,0 +1,86 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "../Ensemble.h"
+#include "../Lattice.h"
+
+TEST_CASE( "ensembles don't depend on the number of threads", "[Ensemble]" ) {
+    Ensemble<2>::Method methods[] = { Ensemble<2>::STEP_BY_STEP, Ensemble<2>::MULTINOMIAL,
+                                      Ensemble<2>::BATCH };
+
+    for (int m = 0; m < 3; ++m) {
+        Ensemble<2> serial(TriLattice(), 1, 8, 100);
+        Ensemble<2> parallel(TriLattice(), 3, 8, 100);
+
+        serial.setMethod(methods[m]);
+        parallel.setMethod(methods[m]);
+
+        // Not a whole number of chunks
+        std::vector<double> expected = serial.run(500, 101);
+        std::vector<double> distances = parallel.run(500, 101);
+
+        REQUIRE( distances == expected );
+    }
+}
+
+TEST_CASE( "the default method doesn't depend on the build", "[Ensemble]" ) {
+    // The batch walk takes the same steps whether it is vectorised or not
+    REQUIRE( Ensemble<2>(TriLattice(), 1, 0, 0).getMethod() == Ensemble<2>::BATCH );
+}
+
+TEST_CASE( "ensemble moments and histogram match the distances", "[Ensemble]" ) {
+    Ensemble<3> ensemble(SimpleCubic(), 4, 2, 0);
+    ensemble.setHistogram(12, 5);
+
+    std::vector<double> distances = ensemble.run(1000, 3000);
+
+    double sum = 0, sum_squares = 0;
+    std::vector<size_t> histogram;
+
+    for (size_t i = 0; i < distances.size(); ++i) {
+        sum += distances[i];
+        sum_squares += distances[i] * distances[i];
+
+        // Everything past the last bin is in it
+        size_t bin = std::min((size_t)(distances[i] / 5), (size_t)11);
+        if (bin >= histogram.size())
+            histogram.resize(12, 0);
+        ++histogram[bin];
+    }
+
+    REQUIRE( ensemble.getCount() == 3000 );
+    REQUIRE( std::abs(ensemble.getMean() - sum / 3000) < 1e-9 );
+    REQUIRE( std::abs(ensemble.getMeanSquare() - sum_squares / 3000) < 1e-6 );
+    REQUIRE( ensemble.getHistogram() == histogram );
+
+    // <R^2> = length on the simple cubic lattice
+    REQUIRE( std::abs(ensemble.getMeanSquare() / 1000 - 1) < 0.1 );
+}
+
+TEST_CASE( "ensembles hand distances on in order as they finish", "[Ensemble]" ) {
+    Ensemble<2> ensemble(TriLattice(), 3, 5, 0);
+
+    // Many times the window, so chunks are handed on while others run
+    std::vector<double> expected = ensemble.run(100, 2000);
+    std::vector<double> received;
+
+    ensemble.run(100, 2000, [&received](double distance) { received.push_back(distance); });
+
+    REQUIRE( received == expected );
+    REQUIRE( ensemble.getCount() == 2000 );
+    REQUIRE( ensemble.getHistogram().empty() );
+
+    // Stopping part way through lets every thread finish
+    size_t calls = 0;
+
+    REQUIRE_THROWS_AS( ensemble.run(100, 2000, [&calls](double) {
+        if (++calls == 100)
+            throw std::runtime_error("stop");
+    }), std::runtime_error );
+
+    REQUIRE( calls == 100 );
+}
@@ -0,0 +1,177 @@
+#include <catch2/catch_all.hpp>
+
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../Image.h"
+#include "../Span.h"
+#include "../Vector.h"
+
+static uint32_t bigEndian(const std::string &s, size_t offset) {
+    uint32_t value = 0;
+
+    for (size_t i = 0; i < 4; ++i)
+        value = (value << 8) | (uint8_t)s[offset + i];
+
+    return value;
+}
+
+TEST_CASE( "checksums match their check values", "[Image]" ) {
+    const std::string check = "123456789";
+    const uint8_t *data = (const uint8_t *)check.data();
+
+    REQUIRE( Image::crc32(data, check.size()) == 0xcbf43926 );
+    REQUIRE( Image::adler32(data, check.size()) == 0x091e01de );
+
+    // Either can be carried on from an earlier part
+    REQUIRE( Image::crc32(data + 4, 5, Image::crc32(data, 4)) == 0xcbf43926 );
+    REQUIRE( Image::adler32(data + 4, 5, Image::adler32(data, 4)) == 0x091e01de );
+
+    // Long enough for the Adler sums to be reduced part way through
+    std::vector<uint8_t> ones(100000, 0xff);
+    uint32_t a = 1, b = 0;
+
+    for (size_t i = 0; i < ones.size(); ++i) {
+        a = (a + 0xff) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    REQUIRE( Image::adler32(ones.data(), ones.size()) == ((b << 16) | a) );
+}
+
+TEST_CASE( "images are written as PGM and PNG", "[Image]" ) {
+    // Rows longer than a stored block in total, so the PNG needs several
+    Image image(300, 400);
+    image.set(0, 0, Image::BLACK);
+    image.fill(290, 390, 20, 20, 7);
+    image.set(-1, 500, Image::BLACK);
+
+    REQUIRE( image.get(299, 399) == 7 );
+    REQUIRE( image.get(1, 1) == Image::WHITE );
+
+    std::ostringstream pgm;
+    image.writePGM(pgm);
+
+    std::string header = "P5\n300 400\n255\n";
+    REQUIRE( pgm.str().compare(0, header.size(), header) == 0 );
+    REQUIRE( pgm.str().size() == header.size() + 300 * 400 );
+    REQUIRE( (uint8_t)pgm.str()[header.size()] == Image::BLACK );
+
+    std::ostringstream written;
+    image.writePNG(written);
+    std::string png = written.str();
+
+    REQUIRE( png.compare(0, 8, "\x89PNG\r\n\x1a\n") == 0 );
+
+    /* Walk the chunks, checking their CRCs and unpacking the stored blocks */
+    std::string raw;
+    size_t offset = 8;
+    std::vector<std::string> types;
+
+    while (offset < png.size()) {
+        uint32_t length = bigEndian(png, offset);
+        std::string type = png.substr(offset + 4, 4);
+        std::string data = png.substr(offset + 8, length);
+
+        REQUIRE( bigEndian(png, offset + 8 + length)
+                 == Image::crc32((const uint8_t *)png.data() + offset + 4, length + 4) );
+
+        if (type == "IHDR") {
+            REQUIRE( bigEndian(data, 0) == 300 );
+            REQUIRE( bigEndian(data, 4) == 400 );
+        }
+
+        if (type == "IDAT") {
+            size_t block = 2;
+            bool last = false;
+
+            while (!last) {
+                last = data[block] & 1;
+                size_t size = (uint8_t)data[block + 1] | (uint8_t)data[block + 2] << 8;
+
+                REQUIRE( (uint16_t)~size == ((uint8_t)data[block + 3] | (uint8_t)data[block + 4] << 8) );
+
+                raw += data.substr(block + 5, size);
+                block += 5 + size;
+            }
+
+            REQUIRE( bigEndian(data, block) == Image::adler32((const uint8_t *)raw.data(), raw.size()) );
+        }
+
+        types.push_back(type);
+        offset += 12 + length;
+    }
+
+    REQUIRE( types.size() == 3 );
+    REQUIRE( types.back() == "IEND" );
+
+    // Each row is its filter byte and then the pixels
+    REQUIRE( raw.size() == 301 * 400 );
+
+    for (int y = 0; y < 400; ++y)
+        for (int x = 0; x < 300; ++x)
+            REQUIRE( (uint8_t)raw[y * 301 + 1 + x] == image.get(x, y) );
+}
+
+TEST_CASE( "seeds are drawn to fit the cluster", "[Image]" ) {
+    std::vector<Vector<2> > seeds;
+    seeds.push_back(Vector<2>(2, 0.0, 0.0));
+    seeds.push_back(Vector<2>(2, -0.5, 1.0));
+    seeds.push_back(Vector<2>(2, 3.0, -2.0));
+
+    SeedRaster raster = SeedRaster::fit(seeds, 2, 1);
+    raster.draw(seeds, true);
+
+    const Image &image = raster.getImage();
+
+    // Pixels -1 to 7 across and -4 to 3 down, plus the margin
+    REQUIRE( image.getWidth() == 9 + 2 );
+    REQUIRE( image.getHeight() == 8 + 2 );
+
+    REQUIRE( image.get(0, 0) == Image::WHITE );
+    REQUIRE( image.get(1 + 1, 1 + 4) == Image::BLACK );
+    REQUIRE( image.get(1 + 0, 1 + 6) == SeedRaster::ARRIVAL_SHADE / 2 );
+    REQUIRE( image.get(1 + 7, 1 + 0) == SeedRaster::ARRIVAL_SHADE );
+}
+
+TEST_CASE( "growth is streamed as Y4M frames", "[Image]" ) {
+    std::ostringstream written;
+    SeedVideo video(written, 9, 1, 30, 2);
+
+    for (int i = 0; i < 5; ++i)
+        video.add(Vector<2>(2, (double)i, 0.0));
+
+    REQUIRE( video.getFrames() == 2 );
+
+    video.finish();
+    video.finish();
+    REQUIRE( video.getFrames() == 3 );
+
+    // Odd sizes are rounded up for the chroma planes
+    std::string header = "YUV4MPEG2 W10 H10 F30:1 Ip A1:1 C420jpeg\n";
+    std::string stream = written.str();
+    const size_t frame = 6 + 10 * 10 + 2 * 5 * 5;
+
+    REQUIRE( stream.compare(0, header.size(), header) == 0 );
+    REQUIRE( stream.size() == header.size() + 3 * frame );
+
+    /* Each frame only has the seeds added before it, (0, 0) being in the
+     * middle of the frame */
+    for (int f = 0; f < 3; ++f) {
+        size_t start = header.size() + f * frame;
+        REQUIRE( stream.compare(start, 6, "FRAME\n") == 0 );
+
+        for (int x = 0; x < 10; ++x) {
+            bool drawn = x >= 5 && x - 5 < 2 * (f + 1);
+            REQUIRE( (uint8_t)stream[start + 6 + 5 * 10 + x] == (drawn ? Image::BLACK : Image::WHITE) );
+        }
+
+        REQUIRE( (uint8_t)stream[start + frame - 1] == 128 );
+    }
+
+    Y4MWriter writer(written, 4, 4, 30);
+    REQUIRE_THROWS_AS( writer.writeFrame(Image(5, 4)), std::out_of_range );
+}
@@ -0,0 +1,231 @@
+#include <catch2/catch_all.hpp>
+
+#include <cmath>
+#include <set>
+#include <vector>
+
+#include "../Lattice.h"
+#include "../Occupancy.h"
+#include "../Random.h"
+
+/* The linear scan DLA::closeToSeed used to do */
+static bool nearLinear(const std::vector<Vector<2> > &seeds, Vector<2> point)
+{
+    for (size_t i = 0; i < seeds.size(); ++i)
+        if ((seeds[i] - point).getMagnitude() < 1.5)
+            return true;
+
+    return false;
+}
+
+TEST_CASE( "halo matches the distance test", "[Occupancy]" ) {
+    const std::vector<Occupancy::Cell> &halo = Occupancy::haloOffsets();
+
+    // 5 cells in x (half units) by 3 rows in y
+    REQUIRE( halo.size() == 15 );
+
+    for (size_t i = 0; i < halo.size(); ++i)
+        REQUIRE( Occupancy::toPoint(halo[i]).getMagnitude() < 1.5 );
+}
+
+TEST_CASE( "cells round trip through points", "[Occupancy]" ) {
+    Vector<2> p(2, -3.5, 7.0);
+    Occupancy::Cell c = Occupancy::toCell(p);
+
+    REQUIRE( c.x == -7 );
+    REQUIRE( c.y == 7 );
+    REQUIRE( Occupancy::toPoint(c) == p );
+}
+
+TEST_CASE( "walkers can step in cells", "[Occupancy]" ) {
+    TriLattice lattice;
+    const std::vector<Vector<2> > &translations = lattice.getTranslationSet();
+    std::vector<Occupancy::Cell> steps = Occupancy::toCells(translations);
+
+    REQUIRE( steps.size() == translations.size() );
+
+    Occupancy::Cell cell;
+    Vector<2> point(2, 0.0, 0.0);
+
+    for (int i = 0; i < 100; ++i) {
+        cell += steps[(i * 7) % steps.size()];
+        point += translations[(i * 7) % steps.size()];
+
+        REQUIRE( cell == Occupancy::toCell(point) );
+        REQUIRE( std::abs(cell.getSquaredMagnitude() - point.getMagnitude() * point.getMagnitude()) < 1e-9 );
+    }
+}
+
+TEST_CASE( "dense grid agrees with a linear scan", "[OccupancyGrid]" ) {
+    OccupancyGrid grid(4, 4);
+    std::vector<Vector<2> > seeds;
+
+    seeds.push_back(Vector<2>(2, 0.0, 0.0));
+    seeds.push_back(Vector<2>(2, 2.5, -1.0));
+    // Outside the initial grid, so it has to grow
+    seeds.push_back(Vector<2>(2, -30.5, 12.0));
+
+    for (size_t i = 0; i < seeds.size(); ++i)
+        grid.add(seeds[i]);
+
+    REQUIRE( grid.getHalfWidth() >= 32 );
+    REQUIRE( grid.isSeed(Occupancy::toCell(seeds[2])) );
+
+    for (int y = -20; y <= 20; ++y) {
+        for (int x = -80; x <= 20; ++x) {
+            Vector<2> point = Occupancy::toPoint(Occupancy::Cell(x, y));
+            REQUIRE( grid.isNearSeed(point) == nearLinear(seeds, point) );
+        }
+    }
+
+    SECTION( "points outside the grid are never near a seed" ) {
+        REQUIRE( !grid.isNearSeed(Vector<2>(2, 10000.0, 0.0)) );
+    }
+}
+
+TEST_CASE( "sparse tiles agree with a linear scan", "[TiledOccupancy]" ) {
+    TiledOccupancy tiles;
+    std::vector<Vector<2> > seeds;
+
+    seeds.push_back(Vector<2>(2, 0.0, 0.0));
+    // Halo straddles the tile boundary at cell x = -1 / 0
+    seeds.push_back(Vector<2>(2, -0.5, 5.0));
+    seeds.push_back(Vector<2>(2, 31.5, 63.0));
+    // Far away from the others, in a tile of its own
+    seeds.push_back(Vector<2>(2, -5000.0, -7000.0));
+
+    for (size_t i = 0; i < seeds.size(); ++i)
+        tiles.add(seeds[i]);
+
+    // Only tiles touched by a halo are allocated
+    REQUIRE( tiles.getTileCount() < 16 );
+
+    for (size_t i = 0; i < seeds.size(); ++i)
+        REQUIRE( tiles.isSeed(Occupancy::toCell(seeds[i])) );
+
+    for (int y = -10; y <= 70; ++y) {
+        for (int x = -70; x <= 70; ++x) {
+            Vector<2> point = Occupancy::toPoint(Occupancy::Cell(x, y));
+            REQUIRE( tiles.isNearSeed(point) == nearLinear(seeds, point) );
+        }
+    }
+
+    for (int y = -7003; y <= -6997; ++y) {
+        for (int x = -10005; x <= -9995; ++x) {
+            Vector<2> point = Occupancy::toPoint(Occupancy::Cell(x, y));
+            REQUIRE( tiles.isNearSeed(point) == nearLinear(seeds, point) );
+        }
+    }
+}
+
+TEST_CASE( "sparse tiles survive rehashing", "[TiledOccupancy]" ) {
+    TiledOccupancy tiles;
+
+    // Enough separate tiles to grow the hash table several times
+    for (int i = 0; i < 500; ++i)
+        tiles.add(Vector<2>(2, i * 100.0, -i * 70.0));
+
+    REQUIRE( tiles.getTileCount() >= 500 );
+
+    for (int i = 0; i < 500; ++i) {
+        REQUIRE( tiles.isNearSeed(Vector<2>(2, i * 100.0 + 1.0, -i * 70.0)) );
+        REQUIRE( !tiles.isNearSeed(Vector<2>(2, i * 100.0 + 2.0, -i * 70.0)) );
+    }
+}
+
+TEST_CASE( "concurrent tiles agree with a linear scan", "[ConcurrentOccupancy]" ) {
+    ConcurrentOccupancy concurrent(200);
+    std::vector<Vector<2> > seeds;
+
+    seeds.push_back(Vector<2>(2, 0.0, 0.0));
+    seeds.push_back(Vector<2>(2, -0.5, 5.0));
+    seeds.push_back(Vector<2>(2, 198.0, -199.0));
+
+    for (size_t i = 0; i < seeds.size(); ++i)
+        concurrent.add(seeds[i]);
+
+    for (int y = -205; y <= 205; y += 5) {
+        for (int x = -410; x <= 410; ++x) {
+            Vector<2> point = Occupancy::toPoint(Occupancy::Cell(x, y));
+            REQUIRE( concurrent.isNearSeed(point) == nearLinear(seeds, point) );
+        }
+    }
+
+    REQUIRE( concurrent.isSeed(Occupancy::toCell(seeds[2])) );
+    REQUIRE_THROWS_AS( concurrent.add(Vector<2>(2, 0.0, 200.0)), std::out_of_range );
+}
+
+TEST_CASE( "snapped offsets stay on the walker's sublattice", "[Occupancy]" ) {
+    Xoshiro256 rng(21);
+
+    for (int i = 0; i < 100000; ++i) {
+        Vector<2> offset(2, (rng.uniform() - 0.5) * 2000, (rng.uniform() - 0.5) * 2000);
+
+        Occupancy::Cell whole = Occupancy::snapOffset(offset, false);
+        Occupancy::Cell half = Occupancy::snapOffset(offset, true);
+
+        // Whole units without half steps, and an even x + y with them
+        REQUIRE( whole.x % 2 == 0 );
+        REQUIRE( (half.x + half.y) % 2 == 0 );
+
+        // Never further off than getEmptyRadius() leaves room for
+        REQUIRE( (Occupancy::toPoint(whole) - offset).getMagnitude() < 1 );
+        REQUIRE( (Occupancy::toPoint(half) - offset).getMagnitude() < 1 );
+    }
+}
+
+TEST_CASE( "jumps of the empty radius never reach a halo", "[OccupancyPyramid]" ) {
+    OccupancyPyramid pyramid;
+    TiledOccupancy tiles;
+    std::vector<Vector<2> > seeds;
+
+    // Seeds on either sublattice, on both sides of block boundaries
+    const int cells[][2] = { { 0, 0 }, { 1, 1 }, { 400, 37 }, { -1001, -601 },
+                             { 2048, 1024 }, { -2047, 1023 }, { 30000, -20000 } };
+
+    for (size_t i = 0; i < sizeof(cells) / sizeof(cells[0]); ++i) {
+        Occupancy::Cell cell(cells[i][0], cells[i][1]);
+
+        pyramid.add(cell);
+        tiles.add(Occupancy::toPoint(cell));
+        seeds.push_back(Occupancy::toPoint(cell));
+    }
+
+    Xoshiro256 rng(22);
+    std::set<double> radii;
+
+    for (int i = 0; i < 20000; ++i) {
+        // From right next to the seeds to far beyond them, so many levels are used
+        double scale = std::pow(2.0, (int)rng.below(18));
+        Occupancy::Cell cell((int)((rng.uniform() - 0.5) * 4 * scale),
+                             (int)((rng.uniform() - 0.5) * 2 * scale));
+        Vector<2> point = Occupancy::toPoint(cell);
+
+        double radius = pyramid.getEmptyRadius(cell);
+
+        if (radius == 0)
+            continue;
+
+        radii.insert(radius);
+
+        double nearest = INFINITY;
+        for (size_t j = 0; j < seeds.size(); ++j)
+            nearest = std::min(nearest, (seeds[j] - point).getMagnitude());
+
+        // The halo reaches 1.5 units out, and snapping moves the landing point under 1
+        REQUIRE( radius + 1 < nearest - 1.5 );
+
+        for (int k = 0; k < 16; ++k) {
+            double angle = k * (M_PI / 8) + rng.uniform();
+            Vector<2> offset(2, radius * std::cos(angle), radius * std::sin(angle));
+
+            Occupancy::Cell landing = cell;
+            landing += Occupancy::snapOffset(offset, k % 2 == 0);
+
+            REQUIRE( !tiles.isNearSeed(landing) );
+        }
+    }
+
+    // Radii from several levels of the pyramid were checked
+    REQUIRE( radii.size() >= 8 );
+}
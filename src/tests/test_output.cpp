@@ -0,0 +1,151 @@
+#include <catch2/catch_all.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "../BinaryFormat.h"
+#include "../Lattice.h"
+#include "../Output.h"
+#include "../Random.h"
+#include "../Walk.h"
+
+static std::string general(double value) {
+    char out[Format::MAX_GENERAL];
+    return std::string(out, Format::general(value, out));
+}
+
+static std::string printed(double value) {
+    std::ostringstream ss;
+    ss << value;
+    return ss.str();
+}
+
+TEST_CASE( "numbers are formatted as streams format them", "[Output]" ) {
+    const double values[] = { 0.0, -0.0, 1, -1, 0.5, 0.1, 0.866025403784, -0.866025,
+                              1.5, 2.59808, 123456, 999999, 999999.5, 1000000, 1e-4, 9.99999e-5,
+                              0.000123456789, 12345.65, 0.30000000000000004, 1e300, -1e-300,
+                              INFINITY, -INFINITY, NAN };
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+        REQUIRE( general(values[i]) == printed(values[i]) );
+
+    // Sums of lattice steps, and plenty of arbitrary values
+    Xoshiro256 rng(5);
+    double sum = 0;
+
+    for (int i = 0; i < 200000; ++i) {
+        sum += (rng.below(2) ? 0.8660254037844386 : -0.5);
+        REQUIRE( general(sum) == printed(sum) );
+
+        double value = (rng.uniform() - 0.5) * std::pow(10.0, (int)rng.below(14) - 6);
+        REQUIRE( general(value) == printed(value) );
+
+        // Exactly representable halves, which sit on a rounding tie
+        double half = ((long long)rng.below(4000000) - 2000000) / 2.0;
+        REQUIRE( general(half) == printed(half) );
+    }
+}
+
+TEST_CASE( "walks are written without being stored", "[Output]" ) {
+    TriLattice lattice;
+
+    for (int accumulate = 0; accumulate < 2; ++accumulate) {
+        Walk<2> walk(lattice, Xoshiro256(8));
+        walk.generate(20000).applyBasis();
+
+        std::string expected = accumulate ? walk.accumulateVectors().toCSV() : walk.toCSV();
+
+        std::ostringstream written;
+        Walk<2> streaming(lattice, Xoshiro256(8));
+        streaming.writeCSV(written, 20000, accumulate);
+
+        REQUIRE( written.str() == expected );
+        REQUIRE( streaming.empty() );
+    }
+}
+
+TEST_CASE( "walks can be written as binary records", "[Output]" ) {
+    Hexagonal lattice;
+
+    Walk<3> walk(lattice, Xoshiro256(3));
+    walk.generate(10000).applyBasis().accumulate();
+
+    std::ostringstream written;
+    {
+        OutputBuffer out(written, 100);
+        Format::writeHeader(out, Format::POSITIONS, 3, lattice, 3);
+
+        Walk<3> streaming(lattice, Xoshiro256(3));
+        streaming.writeBinary(out, 10000, true);
+    }
+
+    std::string bytes = written.str();
+    const size_t header = 48 + 8 * 3;
+
+    REQUIRE( bytes.size() == header + 10000 * 3 * 8 );
+    REQUIRE( bytes.compare(0, 8, std::string("WALKGEN\0", 8)) == 0 );
+    REQUIRE( bytes[12] == Format::POSITIONS );
+    REQUIRE( bytes[16] == 3 );
+    REQUIRE( std::string(bytes.c_str() + 24) == "hexagonal" );
+    REQUIRE( bytes[40] == 3 );
+
+    char record[3 * 8];
+
+    for (size_t i = 0; i < walk.size(); ++i) {
+        REQUIRE( Format::binary(walk[i], record) == sizeof(record) );
+        REQUIRE( bytes.compare(header + i * sizeof(record), sizeof(record),
+                               std::string(record, sizeof(record))) == 0 );
+    }
+}
+
+TEST_CASE( "binary walks can be written into a mapped file", "[Output]" ) {
+    if (!MAPPED_OUTPUT)
+        return;
+
+    TriLattice lattice;
+    const char *filename = "test_mapped_output.bin";
+    // Long enough to hand pages back part way through
+    const long long length = MappedOutput::WINDOW_SIZE / 16 + 100000;
+
+    std::ostringstream buffered;
+    {
+        OutputBuffer out(buffered);
+        Format::writeHeader(out, Format::STEPS, 2, lattice, 7);
+
+        Walk<2> walk(lattice, Xoshiro256(7));
+        walk.writeBinary(out, length, false);
+    }
+
+    // Bigger than needed, so closing has to trim it
+    size_t size = Format::headerSize(2) + length * 16;
+    {
+        MappedOutput out;
+        REQUIRE( out.open(filename, size + 1000) );
+
+        Format::writeHeader(out, Format::STEPS, 2, lattice, 7);
+
+        Walk<2> walk(lattice, Xoshiro256(7));
+        walk.writeBinary(out, length, false);
+
+        REQUIRE( out.tell() == size );
+        REQUIRE_THROWS_AS( out.reserve(1001), std::out_of_range );
+    }
+
+    std::ifstream file(filename, std::ios::binary);
+    std::string mapped((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(filename);
+
+    REQUIRE( mapped.size() == size );
+    REQUIRE( mapped == buffered.str() );
+
+    // Nothing can be mapped, so nothing is left behind
+    MappedOutput empty;
+    REQUIRE( !empty.open(filename, 0) );
+    REQUIRE( !std::ifstream(filename) );
+}
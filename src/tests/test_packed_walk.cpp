@@ -0,0 +1,65 @@
+#include <catch2/catch_all.hpp>
+
+#include <cmath>
+#include <stdexcept>
+
+#include "../Lattice.h"
+#include "../PackedWalk.h"
+#include "../Random.h"
+#include "../Walk.h"
+
+TEST_CASE( "packed walks decode to the same walk", "[PackedWalk]" ) {
+    const size_t length = 3 * PackedWalk<3>::CHECKPOINT_INTERVAL + 123;
+
+    Walk<3> walk(Hexagonal(), Xoshiro256(11));
+    PackedWalk<3> packed(Hexagonal(), Xoshiro256(11));
+
+    walk.generate((int)length);
+    packed.generate(length);
+
+    REQUIRE( packed.size() == length );
+
+    for (size_t i = 0; i < length; ++i)
+        REQUIRE( packed[i] == walk[i] );
+
+    SECTION( "positions match the accumulated walk" ) {
+        Walk<3> positions = walk.accumulateVectors();
+
+        REQUIRE( packed.getPosition(0) == Vector<3>() );
+
+        for (size_t i = 1; i <= length; i += 97)
+            REQUIRE( packed.getPosition(i) == positions[i - 1] );
+
+        REQUIRE( packed.getPosition(length) == positions[length - 1] );
+        REQUIRE_THROWS_AS( packed.getPosition(length + 1), std::out_of_range );
+    }
+
+    SECTION( "distances match the walk with the basis applied" ) {
+        walk.applyBasis();
+
+        REQUIRE( std::abs(packed.getDistance() - walk.getDistance()) < 1e-9 );
+        REQUIRE( std::abs(packed.getDistanceBetween(5000, 9000)
+                          - walk.getDistanceBetween(5000, 9000)) < 1e-9 );
+    }
+
+    SECTION( "unpacking gives the original steps" ) {
+        Walk<3> unpacked = packed.unpack();
+
+        REQUIRE( unpacked.size() == walk.size() );
+
+        for (size_t i = 0; i < length; ++i)
+            REQUIRE( unpacked[i] == walk[i] );
+    }
+}
+
+TEST_CASE( "packed walks use a few bits per step", "[PackedWalk]" ) {
+    PackedWalk<2> square(SquareLattice(), Xoshiro256(3));
+    PackedWalk<2> triangular(TriLattice(), Xoshiro256(3));
+
+    square.generate(64000);
+    triangular.generate(63000);
+
+    // 2 bits per step on the square lattice, 3 on the triangular one
+    REQUIRE( square.getMemoryUsage() < 64000 / 4 + 1024 );
+    REQUIRE( triangular.getMemoryUsage() < 63000 * 3 / 8 + 1024 );
+}
@@ -0,0 +1,52 @@
+#include <catch2/catch_all.hpp>
+
+#include <vector>
+
+#include "../Lattice.h"
+#include "../ParallelDLA.h"
+#include "../Vector.h"
+
+/* Grow `count` seeds on `threads` threads, asking for them in `pieces` */
+static std::vector<Vector<2> > growDeterministic(int threads, uint64_t seed,
+                                                 const std::vector<size_t> &pieces,
+                                                 size_t *reruns = 0) {
+    DeterministicPointDLA dla(TriLattice(), threads, seed);
+    std::vector<Vector<2> > grown;
+
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        std::vector<Vector<2> > piece = dla.grow(pieces[i]);
+
+        REQUIRE( piece.size() == pieces[i] );
+        grown.insert(grown.end(), piece.begin(), piece.end());
+    }
+
+    // The initial seed, then every one grown, in order
+    REQUIRE( dla.getSeedCount() == grown.size() + 1 );
+    REQUIRE( dla.getSeedView().subspan(1, grown.size()).toVector() == grown );
+
+    if (reruns)
+        *reruns = dla.getReruns();
+
+    return grown;
+}
+
+TEST_CASE( "deterministic DLAs don't depend on threads or how seeds are asked for",
+           "[DeterministicPointDLA]" ) {
+    size_t reruns = 0;
+    std::vector<Vector<2> > serial = growDeterministic(1, 7, std::vector<size_t>(1, 400), &reruns);
+
+    // Early batches crowd round a small cluster, so some walkers are re-run
+    REQUIRE( reruns > 0 );
+
+    REQUIRE( growDeterministic(4, 7, std::vector<size_t>(1, 400)) == serial );
+
+    // Pieces that end part way through batches, on a different number of threads
+    const size_t sizes[] = { 1, 30, 100, 5, 264 };
+    std::vector<size_t> pieces(sizes, sizes + sizeof(sizes) / sizeof(sizes[0]));
+
+    REQUIRE( growDeterministic(4, 7, pieces) == serial );
+    REQUIRE( growDeterministic(3, 7, pieces) == serial );
+
+    // A different seed grows a different cluster
+    REQUIRE( growDeterministic(4, 8, std::vector<size_t>(1, 400)) != serial );
+}
@@ -0,0 +1,118 @@
+#include <catch2/catch_all.hpp>
+
+#include <set>
+#include <vector>
+
+#include "../Lattice.h"
+#include "../Random.h"
+#include "../Walk.h"
+
+TEST_CASE( "xoshiro streams are reproducible and independent", "[Xoshiro256]" ) {
+    Xoshiro256 a(42, 0), b(42, 0), c(42, 1), d(43, 0);
+    std::set<uint64_t> outputs;
+
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t x = a.next();
+
+        REQUIRE( x == b.next() );
+
+        outputs.insert(x);
+        outputs.insert(c.next());
+        outputs.insert(d.next());
+    }
+
+    // Different streams or seeds never give the same numbers
+    REQUIRE( outputs.size() == 3000 );
+
+    SECTION( "jumping moves to a different part of the sequence" ) {
+        Xoshiro256 e(42, 0);
+        e.jump();
+
+        for (int i = 0; i < 1000; ++i)
+            REQUIRE( outputs.count(e.next()) == 0 );
+    }
+}
+
+TEST_CASE( "xoshiro draws are in range and roughly uniform", "[Xoshiro256]" ) {
+    Xoshiro256 rng(7);
+    std::vector<int> counts(6, 0);
+
+    for (int i = 0; i < 60000; ++i) {
+        double u = rng.uniform();
+
+        REQUIRE( u >= 0.0 );
+        REQUIRE( u < 1.0 );
+
+        size_t index = rng.below(6);
+
+        REQUIRE( index < 6 );
+        ++counts[index];
+    }
+
+    // Each count is about 10000, with a standard deviation of about 90
+    for (size_t i = 0; i < counts.size(); ++i) {
+        REQUIRE( counts[i] > 9500 );
+        REQUIRE( counts[i] < 10500 );
+    }
+}
+
+TEST_CASE( "philox matches the reference test vectors", "[Philox4x32]" ) {
+    uint32_t out[4];
+
+    uint32_t zero[4] = { 0, 0, 0, 0 };
+    uint32_t zero_key[2] = { 0, 0 };
+    Philox4x32::encrypt(zero, zero_key, out);
+
+    REQUIRE( out[0] == 0x6627e8d5 );
+    REQUIRE( out[1] == 0xe169c58d );
+    REQUIRE( out[2] == 0xbc57ac4c );
+    REQUIRE( out[3] == 0x9b00dbd8 );
+
+    uint32_t pi[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 };
+    uint32_t pi_key[2] = { 0xa4093822, 0x299f31d0 };
+    Philox4x32::encrypt(pi, pi_key, out);
+
+    REQUIRE( out[0] == 0xd16cfe09 );
+    REQUIRE( out[1] == 0x94fdcceb );
+    REQUIRE( out[2] == 0x5001e420 );
+    REQUIRE( out[3] == 0x24126ea1 );
+}
+
+TEST_CASE( "philox draws can be regenerated from anywhere", "[Philox4x32]" ) {
+    Philox4x32 rng(99, 3);
+    std::vector<uint64_t> draws;
+
+    for (int i = 0; i < 100; ++i)
+        draws.push_back(rng.next());
+
+    REQUIRE( rng.tell() == 100 );
+
+    for (uint64_t i = 0; i < draws.size(); ++i)
+        REQUIRE( rng.draw(i) == draws[i] );
+
+    // Seeking to odd and even draws both pick up the sequence exactly
+    rng.seek(37);
+    for (int i = 37; i < 60; ++i)
+        REQUIRE( rng.next() == draws[i] );
+
+    rng.seek(12);
+    REQUIRE( rng.next() == draws[12] );
+
+    REQUIRE( Philox4x32(99, 4).next() != draws[0] );
+    REQUIRE( Philox4x32(98, 3).next() != draws[0] );
+}
+
+TEST_CASE( "counter-based walks can be split into segments", "[Philox4x32]" ) {
+    Walk<3, Philox4x32> serial(SimpleCubic(), Philox4x32(5, 1));
+    serial.generate(1000);
+
+    // Segments generated out of order, as separate workers would
+    Walk<3, Philox4x32> segments(SimpleCubic(), Philox4x32(5, 1));
+
+    for (int start = 900; start >= 0; start -= 100) {
+        segments.generateFrom(start, 100);
+
+        for (int i = 0; i < 100; ++i)
+            REQUIRE( segments[i] == serial[start + i] );
+    }
+}
@@ -0,0 +1,126 @@
+#include <catch2/catch_all.hpp>
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "../Lattice.h"
+#include "../Random.h"
+#include "../Walk.h"
+
+TEST_CASE( "end points are drawn without storing the walk", "[Walk]" ) {
+    Walk<2> walk(TriLattice(), Xoshiro256(21));
+    Walk<2> streaming(TriLattice(), Xoshiro256(21));
+
+    // Consecutive walks come from the same draws either way
+    for (int i = 0; i < 5; ++i) {
+        walk.generate(10000);
+
+        Vector<2> end;
+        for (size_t j = 0; j < walk.size(); ++j)
+            end += walk[j];
+
+        REQUIRE( streaming.generateEnd(10000) == end );
+        REQUIRE( streaming.empty() );
+    }
+}
+
+TEST_CASE( "end points can be sampled for very long walks", "[Walk]" ) {
+    Walk<2> walk(SquareLattice(), Xoshiro256(4));
+
+    const long long length = 1000000000001LL;
+    const int samples = 2000;
+    double mean_square = 0;
+
+    for (int i = 0; i < samples; ++i) {
+        Vector<2> end = walk.sampleEnd(length);
+
+        // Every step changes x + y by one
+        REQUIRE( ((long long)(end.get(0) + end.get(1)) - length) % 2 == 0 );
+
+        mean_square += end.getMagnitude() * end.getMagnitude() / length / samples;
+    }
+
+    // <R^2> = length, and this estimate has a standard deviation of about 0.02
+    REQUIRE( mean_square > 0.9 );
+    REQUIRE( mean_square < 1.1 );
+
+    REQUIRE( walk.sampleEnd(0) == Vector<2>() );
+}
+
+TEST_CASE( "the index gives the same distances as summing", "[Walk]" ) {
+    Walk<3> walk(Hexagonal(), Xoshiro256(6));
+    walk.generate(2000).applyBasis();
+
+    std::vector<std::pair<size_t, size_t> > ranges;
+    std::vector<double> summed;
+
+    for (size_t start = 0; start < 2000; start += 170) {
+        for (size_t end = start; end <= 2000; end += 230) {
+            ranges.push_back(std::make_pair(start, end));
+            summed.push_back(walk.getDistanceBetween(start, end));
+        }
+    }
+
+    REQUIRE( !walk.hasIndex() );
+
+    std::vector<double> indexed = walk.getDistancesBetween(ranges);
+
+    REQUIRE( walk.hasIndex() );
+
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        REQUIRE( std::abs(indexed[i] - summed[i]) < 1e-9 );
+        REQUIRE( std::abs(walk.getDistanceBetween(ranges[i].first, ranges[i].second)
+                          - summed[i]) < 1e-9 );
+    }
+
+    SECTION( "changing the walk drops the index" ) {
+        walk.step();
+        REQUIRE( !walk.hasIndex() );
+
+        walk.buildIndex();
+        REQUIRE( walk.hasIndex() );
+
+        walk.generate(10);
+        REQUIRE( !walk.hasIndex() );
+    }
+}
+
+TEST_CASE( "temporary walks are moved rather than copied", "[Walk]" ) {
+    TriLattice lattice;
+
+    Walk<2> walk(lattice, Xoshiro256(12));
+    walk.generate(5000).applyBasis();
+    Walk<2> positions = walk.accumulateVectors();
+
+    // Chained on a temporary, every step is an rvalue and ends in a move
+    Walk<2> moved = Walk<2>(lattice, Xoshiro256(12)).generate(5000).applyBasis();
+    REQUIRE( moved == walk );
+
+    Walk<2> accumulated = Walk<2>(lattice, Xoshiro256(12)).generate(5000).applyBasis().accumulateVectors();
+    REQUIRE( accumulated == positions );
+
+    const Vector<2> *steps = moved.data();
+    Walk<2> in_place = std::move(moved).accumulateVectors();
+    REQUIRE( in_place.data() == steps );
+    REQUIRE( in_place == positions );
+
+    // Binding the result of a temporary keeps it alive, rather than dangling
+    auto &&bound = Walk<2>(lattice, Xoshiro256(12)).generate(5000).applyBasis();
+    REQUIRE( bound == walk );
+
+    size_t i = 0;
+    for (const Vector<2> &step : Walk<2>(lattice, Xoshiro256(12)).generate(5000).applyBasis())
+        REQUIRE( step == walk[i++] );
+    REQUIRE( i == walk.size() );
+
+    SECTION( "positions can be viewed without another walk" ) {
+        Span<Vector<2> > view = walk.getPositions();
+
+        REQUIRE( view.size() == positions.size() );
+        REQUIRE( view.toVector() == positions );
+
+        walk.accumulate();
+        REQUIRE( walk == positions );
+    }
+}
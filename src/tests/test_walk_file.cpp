@@ -0,0 +1,168 @@
+#include <catch2/catch_all.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "../BinaryFormat.h"
+#include "../Lattice.h"
+#include "../Output.h"
+#include "../Random.h"
+#include "../Walk.h"
+#include "../WalkFile.h"
+
+/* Write a walk of `length` steps drawn from `rng` to `filename` */
+template<unsigned int N>
+static void writeWalkFile(const char *filename, const Lattice<N> &lattice, Xoshiro256 rng,
+                          long long length) {
+    std::ofstream file(filename, std::ios::binary);
+    OutputBuffer out(file);
+    WalkFileWriter<N> writer(out, lattice, 11, length);
+
+    Walk<N> walk(lattice, rng);
+
+    for (long long i = 0; i < length; ++i)
+        writer.add(walk.nextIndex());
+
+    REQUIRE_THROWS_AS( writer.add(0), std::out_of_range );
+}
+
+TEST_CASE( "walk files give back every step and position", "[WalkFile]" ) {
+    TriLattice lattice;
+    const char *filename = "test_walk_file.walk";
+
+    // Part of a block at the end, and exactly full blocks
+    const long long lengths[] = { 3 * WalkFile::BLOCK_STEPS + 1234, 2 * WalkFile::BLOCK_STEPS, 1 };
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+        long long length = lengths[l];
+        writeWalkFile(filename, lattice, Xoshiro256(3), length);
+
+        Walk<2> walk(lattice, Xoshiro256(3));
+        walk.generate(length);
+
+        WalkFileReader<2> reader;
+        REQUIRE( reader.open(filename) );
+        REQUIRE( reader.size() == (uint64_t)length );
+        REQUIRE( reader.getHeader().lattice == "triangular" );
+        REQUIRE( reader.getHeader().seed == 11 );
+
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        REQUIRE( (uint64_t)file.tellg() == reader.getHeader().getFileSize() );
+
+        Vector<2> position;
+        REQUIRE( reader.getPosition(0) == position );
+
+        for (long long i = 0; i < length; ++i) {
+            REQUIRE( reader.getStep(i) == walk[i] );
+
+            position += walk[i];
+            REQUIRE( reader.getPosition(i + 1) == position );
+        }
+
+        REQUIRE_THROWS_AS( reader.getIndex(length), std::out_of_range );
+        REQUIRE_THROWS_AS( reader.getPosition(length + 1), std::out_of_range );
+
+        // Jumping about, rather than in order
+        Xoshiro256 rng(9);
+
+        for (int i = 0; i < 200; ++i) {
+            long long j = (long long)rng.below(length + 1);
+            Vector<2> expected;
+
+            for (long long k = 0; k < j; ++k)
+                expected += walk[k];
+
+            REQUIRE( reader.getPosition(j) == expected );
+        }
+    }
+
+    std::remove(filename);
+}
+
+TEST_CASE( "walk files are decoded as walks are written", "[WalkFile]" ) {
+    TriLattice lattice;
+    const char *filename = "test_walk_file.walk";
+    const long long length = 5 * WalkFile::BLOCK_STEPS + 17;
+
+    writeWalkFile(filename, lattice, Xoshiro256(4), length);
+
+    std::ostringstream expected;
+    Walk<2> walk(lattice, Xoshiro256(4));
+    walk.writeCSV(expected, length, false);
+
+    WalkFileReader<2> reader;
+    REQUIRE( reader.open(filename) );
+
+    std::ostringstream decoded;
+    reader.writeCSV(decoded, 0, length, false);
+    REQUIRE( decoded.str() == expected.str() );
+
+    // A range in the middle is just those lines
+    std::ostringstream part;
+    reader.writeCSV(part, 5000, 9000, false);
+
+    std::istringstream lines(expected.str());
+    std::string line, wanted;
+
+    for (int i = 0; std::getline(lines, line) && i < 9000; ++i)
+        if (i >= 5000)
+            wanted += line + "\n";
+
+    REQUIRE( part.str() == wanted );
+
+    REQUIRE_THROWS_AS( reader.writeCSV(part, 0, length + 1, false), std::out_of_range );
+
+    std::remove(filename);
+}
+
+TEST_CASE( "files that aren't walk files are turned down", "[WalkFile]" ) {
+    std::istringstream empty(""), other(std::string(200, 'x'));
+    WalkFile::Header header;
+
+    REQUIRE( !WalkFile::readHeader(empty, header) );
+    REQUIRE( !WalkFile::readHeader(other, header) );
+
+    WalkFileReader<3> reader;
+    REQUIRE( !reader.open("test_walk_file_missing.walk") );
+}
+
+TEST_CASE( "corrupt walk files are caught rather than read out of bounds", "[WalkFile]" ) {
+    TriLattice lattice;
+    const char *filename = "test_walk_file.walk";
+
+    writeWalkFile(filename, lattice, Xoshiro256(6), 100);
+
+    WalkFileReader<2> reader;
+    REQUIRE( reader.open(filename) );
+    size_t first_word = reader.getHeader().getSize() + 8 * 2;
+
+    SECTION( "a step with no translation" ) {
+        // 3 bits of ones is index 7, but there are only 6 translations
+        std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(first_word);
+        file.put((char)0xff);
+        file.close();
+
+        REQUIRE( reader.open(filename) );
+        REQUIRE_THROWS_AS( reader.getIndex(0), std::out_of_range );
+        REQUIRE_THROWS_AS( reader.getPosition(50), std::out_of_range );
+    }
+
+    SECTION( "blocks of another size" ) {
+        // Big enough to ask for gigabytes a block
+        char block_steps[4];
+        Format::putUint32(1u << 31, block_steps);
+
+        std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(24);
+        file.write(block_steps, sizeof(block_steps));
+        file.close();
+
+        REQUIRE( !reader.open(filename) );
+    }
+
+    std::remove(filename);
+}
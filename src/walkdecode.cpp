@@ -0,0 +1,104 @@
+#include <iostream>
+#include <string>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "WalkFile.h"
+
+const std::string USAGE = "walk-decode [file] [start] [end] -a --info";
+
+/**
+ * Print steps `start` to `end` of the walk file, stopping at the end of the
+ * walk, or the whole walk if `end` is 0, in the format walkrun prints walks
+ * in (without the blank line walkrun ends with) */
+template<unsigned int N>
+int decode(const std::string &filename, uint64_t start, uint64_t end, bool accumulate)
+{
+    WalkFileReader<N> reader;
+
+    if (!reader.open(filename)) {
+        std::cerr << "couldn't read " << filename << std::endl;
+        return -1;
+    }
+
+    if (end == 0 || end > reader.size())
+        end = reader.size();
+
+    if (start >= end)
+        return 0;
+
+    try {
+        reader.writeCSV(std::cout, start, end, accumulate);
+    } catch (std::out_of_range &e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filename;
+    uint64_t range[2] = { 0, 0 };
+    int range_args = 0;
+
+    bool accumulate = false;
+    bool info = false;
+
+    /* Parse all the command-line args */
+    for (int n = 1; n < argc; ++n) {
+        if (!std::strcmp(argv[n], "-a")) {
+            accumulate = true;
+        } else if (!std::strcmp(argv[n], "--info")) {
+            info = true;
+        } else if (filename.empty()) {
+            filename = argv[n];
+        } else if (range_args < 2) {
+            range[range_args++] = std::strtoull(argv[n], 0, 10);
+        } else {
+            std::cout << USAGE << std::endl;
+            return -1;
+        }
+    }
+
+    if (filename.empty()) {
+        std::cout << USAGE << std::endl;
+        return -1;
+    }
+
+    // Find the dimension, and everything else --info prints
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    WalkFile::Header header;
+
+    if (!file || !WalkFile::readHeader(file, header)) {
+        std::cerr << "not a walk file: " << filename << std::endl;
+        return -1;
+    }
+
+    if (info) {
+        std::cout << "lattice: " << header.lattice << std::endl
+                  << "dimension: " << header.dimension << std::endl
+                  << "steps: " << header.length << std::endl
+                  << "seed: " << header.seed << std::endl
+                  << "bits per step: " << header.bits << std::endl;
+        return 0;
+    }
+
+    // Just a start prints to the end
+    uint64_t start = range[0], end = range_args == 2 ? range[1] : 0;
+
+    if (range_args == 2 && end <= start)
+        return 0;
+
+    if (header.dimension == 2)
+        return decode<2>(filename, start, end, accumulate);
+
+    if (header.dimension == 3)
+        return decode<3>(filename, start, end, accumulate);
+
+    std::cerr << "can't decode walks of dimension " << header.dimension << std::endl;
+    return -1;
+}
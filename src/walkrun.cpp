@@ -1,29 +1,291 @@
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
 
+#include <csignal>
+#include <cstdint>
 #include <cstring>
 #include <cstdlib>
 #include <ctime>
 
+#include "BinaryFormat.h"
 #include "DLA.h"
+#include "Ensemble.h"
+#include "Image.h"
+#include "Output.h"
+#include "ParallelDLA.h"
 #include "Walk.h"
+#include "WalkFile.h"
 #include "Lattice.h"
 
 #define DEFAULT_LENGTH 200000 // default walk length
 
+#define PARALLEL_DLA_BATCH 1000 // seeds grown between outputs with --threads
+
+#define BINARY_BUFFER_SIZE (1 << 20) // bytes buffered by --format bin
+
+#define IMAGE_MARGIN 4 // pixels of background around the cluster with --image
+
+#define DEFAULT_VIDEO_SIZE 600 // width and height of --video frames
+#define DEFAULT_VIDEO_FPS 60
+#define DEFAULT_FRAME_INTERVAL 10 // seeds between --video frames
+
 const std::string USAGE = "walkrun [length] -a -s --3D --hex"
     " -d [num-distances] --DLA "
-    " --lineDLA --linewidth [width] --fractal --stickiness [s] --silent";
+    " --lineDLA --linewidth [width] --fractal --stickiness [s] --silent"
+    " --occupancy [scan|grid|tiles] --jumps --return --threads [n]"
+    " --deterministic --seed [s] --multinomial --format [csv|bin|packed]"
+    " --image [file] --scale [pixels] --shade --particles [n]"
+    " --video [file|-] --size [pixels] --fps [n] --frame-every [n] --output [file]";
+
+/* Set by SIGINT or SIGTERM with --format bin, --image or --video, so the DLAs
+ * stop and flush their output or finish their pictures */
+volatile std::sig_atomic_t stop_requested = 0;
+
+void requestStop(int)
+{
+    stop_requested = 1;
+}
+
+/**
+ * Print a DLA seed, or N vs. R once it has stuck, as a line of text, or as a
+ * binary record if `binary` isn't null */
+void printSeed(const Vector<2> &seed, size_t N, double R, bool fractal_dimension,
+               OutputBuffer *binary)
+{
+    if (binary) {
+        Vector<2> record = fractal_dimension ? Vector<2>(2, (double)N, R) : seed;
+        binary->commit(Format::binary(record, binary->reserve(2 * sizeof(double))));
+    } else if (fractal_dimension) {
+        std::cout << N << ", " << R << std::endl;
+    } else {
+        std::cout << seed << std::endl;
+    }
+}
+
+/**
+ * Grow one of the parallel DLAs until the user manually stops it, or until
+ * `particles` more seeds have stuck if that isn't 0, printing the seeds (or
+ * N vs. R) in the same format as the serial DLA */
+template<class ParallelDLA>
+int growUntilStopped(ParallelDLA &dla, size_t particles, bool fractal_dimension,
+                     OutputBuffer *binary, bool suppress_output)
+{
+    size_t N = dla.getSeedCount();
+    size_t end = N + particles;
+    double R = 0;
+
+    while (!stop_requested && (particles == 0 || N < end)) {
+        std::vector<Vector<2> > points;
+        size_t batch = PARALLEL_DLA_BATCH;
+
+        if (particles != 0)
+            batch = std::min(batch, end - N);
+
+        try {
+            points = dla.grow(batch);
+        } catch (std::out_of_range &e) {
+            std::cerr << e.what() << std::endl;
+            return -1;
+        }
+
+        for (size_t i = 0; i < points.size(); ++i) {
+            R = std::max(R, points[i].getMagnitude());
+            ++N;
+
+            if (!suppress_output)
+                printSeed(points[i], N, R, fractal_dimension, binary);
+        }
+    }
+
+    return 0;
+}
+
+/* Pictures of a DLA: a video as it grows, and an image once it stops */
+struct Drawing {
+    Drawing() : scale(2), by_arrival(false) { }
+
+    // No image if empty
+    std::string image_file;
+    int scale;
+    bool by_arrival;
+
+    // No video if null
+    std::unique_ptr<SeedVideo> video;
+};
+
+/* Start the video (if any) from the DLA's current seeds, adding each new one as it sticks */
+void startDrawing(DLA &dla, Drawing &drawing)
+{
+    if (!drawing.video)
+        return;
+
+    SeedVideo *video = drawing.video.get();
+    Span<Vector<2> > seeds = dla.getSeedView();
+
+    for (size_t i = 0; i < seeds.size(); ++i)
+        video->add(seeds[i]);
+
+    dla.addSeedObserver([video](const Vector<2> &seed, size_t) { video->add(seed); });
+}
+
+/**
+ * Write the last frame of the video, and draw every seed of the DLA to the
+ * image file (see Image::save()), returning `result`, or -1 if the image
+ * couldn't be written */
+int finishDrawing(const DLA &dla, Drawing &drawing, int result)
+{
+    if (drawing.video)
+        drawing.video->finish();
+
+    if (drawing.image_file.empty())
+        return result;
+
+    SeedRaster raster = SeedRaster::fit(dla.getSeedView(), drawing.scale, IMAGE_MARGIN);
+    raster.draw(dla.getSeedView(), drawing.by_arrival);
+
+    if (!raster.getImage().save(drawing.image_file)) {
+        std::cerr << "couldn't write " << drawing.image_file << std::endl;
+        return -1;
+    }
+
+    return result;
+}
+
+/**
+ * Print the distance between the start and end of `count` walks of `length`
+ * steps, truncated to an integer, running the walks on `threads` threads and
+ * printing each distance as soon as every walk before it has finished */
+template<unsigned int N>
+void printDistances(Lattice<N> lattice, long long length, size_t count, bool multinomial,
+                    int threads, OutputBuffer *binary, bool suppress_output)
+{
+    Ensemble<N> ensemble(lattice, threads, WalkRNG::getSeed(), WalkRNG::nextStream(count));
+
+    if (multinomial)
+        ensemble.setMethod(Ensemble<N>::MULTINOMIAL);
+
+    // Still run the walks, for timing, as printWalk() does
+    if (suppress_output) {
+        ensemble.run(length, count, [](double) { });
+        return;
+    }
+
+    if (binary) {
+        // Binary records keep every digit of the distance
+        Format::writeHeader(*binary, Format::DISTANCES, 1, lattice, WalkRNG::getSeed());
+
+        ensemble.run(length, count, [binary](double distance) {
+            Format::putDouble(distance, binary->reserve(8));
+            binary->commit(8);
+        });
+
+        return;
+    }
+
+    ensemble.run(length, count, [](double distance) { std::cout << (int)distance << std::endl; });
+}
+
+/**
+ * Print a walk of `length` steps with the basis applied, each step (or, if
+ * `accumulate`, the position after it) as a line of CSV, or as a binary record
+ * if `binary` isn't null */
+template<unsigned int N>
+void printWalk(Lattice<N> lattice, long long length, bool accumulate, OutputBuffer *binary,
+               bool suppress_output)
+{
+    Walk<N> random_walk(lattice);
+
+    /* --silent still draws every step, as it always has, so it can time
+     * walks without the cost of writing them out */
+    if (suppress_output) {
+        random_walk.generateEnd(length);
+        return;
+    }
+
+    /* Generate the random walk, applying the basis set and accumulating
+     * the vectors at each step if asked, as it is written out */
+    if (binary) {
+        Format::writeHeader(*binary, accumulate ? Format::POSITIONS : Format::STEPS, N,
+                            lattice, WalkRNG::getSeed());
+        random_walk.writeBinary(*binary, length, accumulate);
+    } else {
+        random_walk.writeCSV(std::cout, length, accumulate);
+        std::cout << std::endl;
+    }
+}
+
+/**
+ * Write a walk as printWalk() does in binary, but straight into `filename`
+ * through a MappedOutput sized for the whole walk. Returns -1 if the file
+ * couldn't be mapped */
+template<unsigned int N>
+int writeMappedWalk(Lattice<N> lattice, long long length, bool accumulate,
+                    const std::string &filename)
+{
+    Walk<N> random_walk(lattice);
+    MappedOutput out;
+
+    if (!out.open(filename, Format::headerSize(N) + (size_t)length * 8 * N)) {
+        std::cerr << "couldn't map " << filename << std::endl;
+        return -1;
+    }
+
+    Format::writeHeader(out, accumulate ? Format::POSITIONS : Format::STEPS, N,
+                        lattice, WalkRNG::getSeed());
+    random_walk.writeBinary(out, length, accumulate);
+
+    return 0;
+}
+
+/**
+ * Write a walk as a compressed walk file (see WalkFile.h) to `filename`
+ * through a MappedOutput, or to stdout if it is empty. Returns -1 if the file
+ * couldn't be mapped */
+template<unsigned int N>
+int writePackedWalk(Lattice<N> lattice, long long length, const std::string &filename)
+{
+    Walk<N> random_walk(lattice);
+
+    if (filename.empty()) {
+        OutputBuffer out(std::cout, BINARY_BUFFER_SIZE);
+        WalkFileWriter<N> writer(out, lattice, WalkRNG::getSeed(), length);
 
+        for (long long i = 0; i < length; ++i)
+            writer.add(random_walk.nextIndex());
+
+        return 0;
+    }
+
+    WalkFile::Header header = WalkFile::makeHeader(lattice, WalkRNG::getSeed(), length);
+    MappedOutput out;
+
+    if (!out.open(filename, header.getFileSize())) {
+        std::cerr << "couldn't map " << filename << std::endl;
+        return -1;
+    }
+
+    WalkFileWriter<N, MappedOutput> writer(out, lattice, WalkRNG::getSeed(), length);
+
+    for (long long i = 0; i < length; ++i)
+        writer.add(random_walk.nextIndex());
+
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
-    int walk_length = DEFAULT_LENGTH;
+    long long walk_length = DEFAULT_LENGTH;
 
     bool accumulate = false;
 
     bool distance = false;
     int distance_count = 10;
+    bool multinomial = false;
 
     bool square = false;
 
@@ -41,6 +303,34 @@ int main(int argc, char *argv[])
 
     bool suppress_output = false;
 
+    bool long_jumps = false;
+    bool return_to_circle = false;
+
+    int threads = 0;
+    bool deterministic = false;
+    uint64_t seed = (uint64_t)std::time(0);
+
+    // Leave each DLA with its own default unless --occupancy is given
+    bool set_occupancy = false;
+    DLA::OccupancyMode occupancy_mode = DLA::DENSE_GRID;
+
+    bool binary_format = false;
+    bool packed_format = false;
+
+    // Write binary walks straight into this file, if given
+    std::string output_file;
+
+    Drawing drawing;
+
+    // Stream video of the DLA here, if given ("-" for stdout)
+    std::string video_file;
+    int video_size = DEFAULT_VIDEO_SIZE;
+    int video_fps = DEFAULT_VIDEO_FPS;
+    size_t frame_interval = DEFAULT_FRAME_INTERVAL;
+
+    // Stop the DLAs after this many more seeds, if not 0
+    size_t particles = 0;
+
     /* Parse all the command-line args */
     for (int n = 1; n < argc; ++n) {
         if (!std::strcmp(argv[n], "-a")) {
@@ -69,12 +359,135 @@ int main(int argc, char *argv[])
             fractal_dimension = true;
         } else if (!std::strcmp(argv[n], "--silent")) {
             suppress_output = true;
-        } else if (!(walk_length = std::atoi(argv[n]))) {
+        } else if (!std::strcmp(argv[n], "--jumps")) {
+            long_jumps = true;
+        } else if (!std::strcmp(argv[n], "--return")) {
+            return_to_circle = true;
+        } else if (!std::strcmp(argv[n], "--threads") && n != argc - 1) {
+            threads = std::atoi(argv[++n]);
+        } else if (!std::strcmp(argv[n], "--deterministic")) {
+            deterministic = true;
+        } else if (!std::strcmp(argv[n], "--seed") && n != argc - 1) {
+            seed = std::strtoull(argv[++n], 0, 10);
+        } else if (!std::strcmp(argv[n], "--occupancy") && n != argc - 1) {
+            ++n;
+
+            if (!std::strcmp(argv[n], "scan")) {
+                occupancy_mode = DLA::LINEAR_SCAN;
+            } else if (!std::strcmp(argv[n], "grid")) {
+                occupancy_mode = DLA::DENSE_GRID;
+            } else if (!std::strcmp(argv[n], "tiles")) {
+                occupancy_mode = DLA::SPARSE_TILES;
+            } else {
+                std::cout << USAGE << std::endl;
+                return -1;
+            }
+
+            set_occupancy = true;
+        } else if (!std::strcmp(argv[n], "--multinomial")) {
+            multinomial = true;
+        } else if (!std::strcmp(argv[n], "--image") && n != argc - 1) {
+            drawing.image_file = argv[++n];
+        } else if (!std::strcmp(argv[n], "--scale") && n != argc - 1) {
+            drawing.scale = std::max(std::atoi(argv[++n]), 1);
+        } else if (!std::strcmp(argv[n], "--shade")) {
+            drawing.by_arrival = true;
+        } else if (!std::strcmp(argv[n], "--video") && n != argc - 1) {
+            video_file = argv[++n];
+        } else if (!std::strcmp(argv[n], "--size") && n != argc - 1) {
+            video_size = std::max(std::atoi(argv[++n]), 2);
+        } else if (!std::strcmp(argv[n], "--fps") && n != argc - 1) {
+            video_fps = std::max(std::atoi(argv[++n]), 1);
+        } else if (!std::strcmp(argv[n], "--frame-every") && n != argc - 1) {
+            frame_interval = std::strtoull(argv[++n], 0, 10);
+        } else if (!std::strcmp(argv[n], "--particles") && n != argc - 1) {
+            particles = std::strtoull(argv[++n], 0, 10);
+        } else if (!std::strcmp(argv[n], "--output") && n != argc - 1) {
+            output_file = argv[++n];
+        } else if (!std::strcmp(argv[n], "--format") && n != argc - 1) {
+            ++n;
+
+            binary_format = packed_format = false;
+
+            if (!std::strcmp(argv[n], "bin")) {
+                binary_format = true;
+            } else if (!std::strcmp(argv[n], "packed")) {
+                packed_format = true;
+            } else if (std::strcmp(argv[n], "csv")) {
+                std::cout << USAGE << std::endl;
+                return -1;
+            }
+        } else if (!(walk_length = std::atoll(argv[n]))) {
             std::cout << USAGE << std::endl;
             return -1;
         }
     }
 
+    WalkRNG::setSeed(seed);
+
+    if (distance && distance_count < 0) {
+        std::cerr << "-d needs a number of walks that isn't negative" << std::endl;
+        return -1;
+    }
+
+    // Only walks know their size in advance
+    if ((!output_file.empty() || packed_format) && (distance || pointDLA || lineDLA)) {
+        std::cerr << "--output and --format packed only apply to walks" << std::endl;
+        return -1;
+    }
+
+    /* The parallel point DLAs always jump and return their walkers to the
+     * launch circle, on an occupancy map of their own */
+    if (pointDLA && (threads > 0 || deterministic) && (long_jumps || return_to_circle || set_occupancy)) {
+        std::cerr << "--jumps, --return and --occupancy only apply to --DLA without --threads"
+                     " or --deterministic, which always jump and return" << std::endl;
+        return -1;
+    }
+
+    // Only the (2D) DLAs have anything to draw
+    if ((!video_file.empty() || !drawing.image_file.empty())
+        && (!(pointDLA || lineDLA) || simplecubic || hexagonal)) {
+        std::cerr << "--image and --video only apply to --DLA and --lineDLA" << std::endl;
+        return -1;
+    }
+
+    // -d uses every core unless told otherwise
+    int distance_threads = threads > 0 ? threads : (int)std::thread::hardware_concurrency();
+
+    /* Video on stdout replaces the usual output, and otherwise goes to its
+     * own file */
+    std::ofstream video_stream;
+
+    if (video_file == "-") {
+        drawing.video.reset(new SeedVideo(std::cout, video_size, drawing.scale, video_fps,
+                                          frame_interval));
+        suppress_output = true;
+    } else if (!video_file.empty()) {
+        video_stream.open(video_file.c_str(), std::ios::binary);
+
+        if (!video_stream) {
+            std::cerr << "couldn't write " << video_file << std::endl;
+            return -1;
+        }
+
+        drawing.video.reset(new SeedVideo(video_stream, video_size, drawing.scale, video_fps,
+                                          frame_interval));
+    }
+
+    /* Binary output goes through one big buffer, flushed when main() returns,
+     * and pictures are finished once the DLA stops, so the endless DLAs stop
+     * on a signal rather than being killed */
+    OutputBuffer binary_buffer(std::cout, BINARY_BUFFER_SIZE);
+    OutputBuffer *binary = 0;
+
+    if (binary_format && !suppress_output)
+        binary = &binary_buffer;
+
+    if (binary || !drawing.image_file.empty() || drawing.video) {
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+    }
+
     // Use 3D lattice
     if (simplecubic || hexagonal) {
         Lattice<3> lattice;
@@ -84,30 +497,19 @@ int main(int argc, char *argv[])
         else if (hexagonal)
             lattice = Hexagonal();
 
-        /* Generate the random walk, applying the basis set */
-        Walk<3> random_walk = Walk<3>(lattice).generate(walk_length).applyBasis();
-
-        // TODO: Currently just copied from below...move it
         // Calculate and print the distance between the start and end point of the walk
         if (distance) {
-            // invariant: i random walk distances have been calculated
-            for (int i = 0; i < distance_count; ++i) {
-                int distance = random_walk.getDistance();
-
-                if (!suppress_output)
-                    std::cout << distance << std::endl;
-
-                random_walk.generate(walk_length).applyBasis();
-            }
-
-        // Accumulate the vectors at each step
-        } else if (accumulate) {
-            if (!suppress_output)
-            std::cout << random_walk.accumulateVectors().toCSV() << std::endl;
-        // Print out the vectors without accumulating them
+            printDistances(lattice, walk_length, distance_count, multinomial,
+                           distance_threads, binary, suppress_output);
+        } else if (suppress_output) {
+            // Nothing is written, whatever the format or --output
+            printWalk(lattice, walk_length, accumulate, binary, suppress_output);
+        } else if (packed_format) {
+            return writePackedWalk(lattice, walk_length, output_file);
+        } else if (!output_file.empty()) {
+            return writeMappedWalk(lattice, walk_length, accumulate, output_file);
         } else {
-            if (!suppress_output)
-            std::cout << random_walk.toCSV() << std::endl;
+            printWalk(lattice, walk_length, accumulate, binary, suppress_output);
         }
 
         return 0;
@@ -121,76 +523,106 @@ int main(int argc, char *argv[])
             lattice = TriLattice();
         }
 
+        // The line DLA has no --fractal mode
+        if ((pointDLA || lineDLA) && binary)
+            Format::writeHeader(*binary, pointDLA && fractal_dimension ? Format::RADII : Format::SEEDS,
+                                2, lattice, seed);
+
+        // Generate a diffusion limited aggregation on several threads
+        if (pointDLA && deterministic) {
+            DeterministicPointDLA dla(lattice, std::max(threads, 1), seed, stickiness);
+            startDrawing(dla, drawing);
+
+            int result = growUntilStopped(dla, particles, fractal_dimension, binary, suppress_output);
+
+            return finishDrawing(dla, drawing, result);
+        }
+
+        if (pointDLA && threads > 0) {
+            ParallelPointDLA dla(lattice, threads, stickiness);
+            startDrawing(dla, drawing);
+
+            int result = growUntilStopped(dla, particles, fractal_dimension, binary, suppress_output);
+
+            return finishDrawing(dla, drawing, result);
+        }
+
         // Generate a diffusion limited aggregation
         if (pointDLA) {
             Walk<2> walk(lattice);
             PointDLA dla(stickiness);
+            if (set_occupancy)
+                dla.setOccupancyMode(occupancy_mode);
+            dla.setLongJumps(long_jumps);
+            if (return_to_circle)
+                dla.setBoundaryMode(PointDLA::RETURN_TO_CIRCLE);
+
+            /* Print each seed as it sticks, or N vs. R, where R is the
+             * furthest radius so far (as getFurthestRadius() will be once
+             * simulateInRadius() returns) */
+            double R = 0;
+
+            if (!suppress_output) {
+                dla.addSeedObserver([&R, fractal_dimension, binary](const Vector<2> &seed, size_t N) {
+                    R = std::max(R, seed.getMagnitude());
+                    printSeed(seed, N, R, fractal_dimension, binary);
+                });
+            }
 
-            /* Generate until user manually stops it */
-            for (;;) {
-                if (fractal_dimension) {
-                    dla.simulateInRadius(walk);
-
-                    // Output N vs. R
-                    auto N = dla.getSeeds().size();
-                    double R = dla.getFurthestRadius();
+            startDrawing(dla, drawing);
 
-                    if (!suppress_output)
-                        std::cout << N << ", " << R << std::endl;
-                } else {
-                    Vector<2> point = dla.simulateInRadius(walk);
+            /* Generate until user manually stops it, or there are enough particles */
+            size_t end = dla.getSeedCount() + particles;
 
-                    if (!suppress_output)
-                        std::cout << point << std::endl;
-                }
-            }
+            while (!stop_requested && (particles == 0 || dla.getSeedCount() < end))
+                dla.simulateInRadius(walk);
 
-            return 0;
+            return finishDrawing(dla, drawing, 0);
         }
 
         if (lineDLA) {
             Walk<2> walk(lattice);
 
             LineDLA dla(line_width, stickiness);
+            if (set_occupancy)
+                dla.setOccupancyMode(occupancy_mode);
 
-            // Output the initial seeds (TODO: Don't do this here...)
-            for (int x = -line_width; x <= line_width; ++x) {
-            if (!suppress_output)
-                std::cout << Vector<2>(2, (double)x, 0.0) << std::endl;
-            }
+            // Output the initial seeds, and then each new one as it sticks
+            if (!suppress_output) {
+                Span<Vector<2> > seeds = dla.getSeedView();
 
-            /* Generate until user manually stops it */
-            for (;;) {
-            Vector<2> point = dla.simulate(walk);
-            if (!suppress_output)
-                std::cout << point << std::endl;
+                for (size_t i = 0; i < seeds.size(); ++i)
+                    printSeed(seeds[i], i + 1, 0, false, binary);
+
+                dla.addSeedObserver([binary](const Vector<2> &seed, size_t N) {
+                    printSeed(seed, N, 0, false, binary);
+                });
             }
 
-            return 0;
-        }
+            startDrawing(dla, drawing);
 
-        /* Generate the random walk, applying the basis set */
-        Walk<2> random_walk = Walk<2>(lattice).generate(walk_length).applyBasis();
+            /* Generate until user manually stops it, or there are enough particles */
+            size_t end = dla.getSeedCount() + particles;
 
-        // Calculate and print the distance between the start and end point of the walk
-        if (distance) {
-            // invariant: i random walk distances have been calculated
-            for (int i = 0; i < distance_count; ++i) {
-                int distance = random_walk.getDistance();
+            while (!stop_requested && (particles == 0 || dla.getSeedCount() < end))
+                dla.simulate(walk);
 
-                if (!suppress_output)
-                    std::cout << distance << std::endl;
+            return finishDrawing(dla, drawing, 0);
+        }
 
-                random_walk.generate(walk_length).applyBasis();
-            }
-        // Accumulate the vectors at each step
-        } else if (accumulate) {
-            if (!suppress_output)
-            std::cout << random_walk.accumulateVectors().toCSV() << std::endl;
-        // Print out the vectors without accumulating them
+        // Calculate and print the distance between the start and end point of the walk
+        if (distance) {
+            printDistances(lattice, walk_length, distance_count, multinomial,
+                           distance_threads, binary, suppress_output);
+        } else if (suppress_output) {
+            // Nothing is written, whatever the format or --output
+            printWalk(lattice, walk_length, accumulate, binary, suppress_output);
+        } else if (packed_format) {
+            return writePackedWalk(lattice, walk_length, output_file);
+        } else if (!output_file.empty()) {
+            return writeMappedWalk(lattice, walk_length, accumulate, output_file);
         } else {
-            if (!suppress_output)
-            std::cout << random_walk.toCSV() << std::endl;
+            printWalk(lattice, walk_length, accumulate, binary, suppress_output);
         }
     }
 